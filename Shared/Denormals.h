@@ -0,0 +1,91 @@
+/*
+Abstract:
+Keeping denormal floats out of the render path
+*/
+
+#include <math.h>
+
+#if defined(__SSE__) || defined(__x86_64__) || defined(_M_X64)
+	#include <xmmintrin.h>
+#endif
+
+#ifndef __Denormals_h__
+#define __Denormals_h__
+
+// Nothing in this file depends on the AU SDK or Core Foundation, so the DSP cores and the
+//  offline tools can use it as well as the audio units.
+
+// Set to 0 to store feedback values as they are, however small; the render guard below
+//  still flushes them on processors it knows about.
+#ifndef SCRUB_DENORMALS
+	#define SCRUB_DENORMALS 1
+#endif
+
+// Feedback values smaller than this (about -300 dB) are stored as 0. It is far above the
+//  largest denormal, so a line that decays through it never reaches one, even after the
+//  averaging the delay lines do.
+static const float kDenormalThreshold = 1e-15f;
+
+// inValue, or 0 once it has decayed below kDenormalThreshold. Written as a select so a
+//  loop over lanes stays a vector compare and mask.
+inline float ScrubDenormal (float inValue) {
+#if SCRUB_DENORMALS
+	return (fabsf (inValue) < kDenormalThreshold) ? 0.0f : inValue;
+#else
+	return inValue;
+#endif
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// DenormalGuard
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Turns on flush-to-zero (and denormals-are-zero where there is one) for the lifetime of
+//  the object and puts the caller's floating point mode back afterwards, so the host
+//  thread we render on keeps its own settings. Meant for the scope of one render call.
+//  Does nothing on processors other than x86 and ARM.
+#pragma mark ____DenormalGuard
+class DenormalGuard {
+	public:
+		DenormalGuard (bool inEnable = true) : mEnabled (inEnable) {
+			if (!mEnabled) return;
+#if defined(__SSE__) || defined(__x86_64__) || defined(_M_X64)
+			mSavedMode = _mm_getcsr ();
+			_mm_setcsr (mSavedMode | kFlushToZero | kDenormalsAreZero);
+#elif defined(__aarch64__)
+			__asm__ __volatile__ ("mrs %0, fpcr" : "=r" (mSavedMode));
+			__asm__ __volatile__ ("msr fpcr, %0" : : "r" (mSavedMode | kFlushToZero));
+#elif defined(__arm__) && defined(__VFP_FP__) && !defined(__SOFTFP__)
+			__asm__ __volatile__ ("vmrs %0, fpscr" : "=r" (mSavedMode));
+			__asm__ __volatile__ ("vmsr fpscr, %0" : : "r" (mSavedMode | kFlushToZero));
+#endif
+		}
+
+		~DenormalGuard () {
+			if (!mEnabled) return;
+#if defined(__SSE__) || defined(__x86_64__) || defined(_M_X64)
+			_mm_setcsr (mSavedMode);
+#elif defined(__aarch64__)
+			__asm__ __volatile__ ("msr fpcr, %0" : : "r" (mSavedMode));
+#elif defined(__arm__) && defined(__VFP_FP__) && !defined(__SOFTFP__)
+			__asm__ __volatile__ ("vmsr fpscr, %0" : : "r" (mSavedMode));
+#endif
+		}
+
+	private:
+		DenormalGuard (const DenormalGuard &);
+		DenormalGuard &operator= (const DenormalGuard &);
+
+#if defined(__SSE__) || defined(__x86_64__) || defined(_M_X64)
+		enum {kFlushToZero = 0x8000, kDenormalsAreZero = 0x0040};	// MXCSR bits
+		unsigned int	mSavedMode = 0;
+#elif defined(__aarch64__)
+		enum {kFlushToZero = 1 << 24};		// FPCR.FZ
+		unsigned long	mSavedMode = 0;
+#elif defined(__arm__)
+		enum {kFlushToZero = 1 << 24};		// FPSCR.FZ
+		unsigned int	mSavedMode = 0;
+#endif
+		bool			mEnabled;
+};
+
+#endif
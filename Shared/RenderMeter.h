@@ -0,0 +1,233 @@
+/*
+Abstract:
+Counting what each render of an audio unit costs
+*/
+
+#include <atomic>
+#include <stdint.h>
+#include <string.h>
+
+// Set to 0 to time renders with CLOCK_MONOTONIC on macOS too, as the offline tools do so
+//  they build without the Core Audio headers.
+#ifndef RENDER_METER_HOST_TIME
+	#if defined(__APPLE__)
+		#define RENDER_METER_HOST_TIME 1
+	#else
+		#define RENDER_METER_HOST_TIME 0
+	#endif
+#endif
+
+#if RENDER_METER_HOST_TIME
+	#include "CAHostTimeBase.h"
+#else
+	#include <time.h>
+#endif
+
+#ifndef __RenderMeter_h__
+#define __RenderMeter_h__
+
+// Nothing in this file depends on the AU SDK. The audio units publish a RenderMeter
+//  through custom properties, and the offline tools use it to time their blocks.
+
+static const uint32_t kRenderMeterVersion = 1;
+static const int kRenderMeterKernels = 8;		// kernels timed one by one; any beyond add to the last
+static const int kRenderMeterBins = 11;			// tenths of the deadline, then the renders that missed it
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// RenderMeterStats
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// What a RenderMeter has counted since the unit was last initialized. The deadline of a
+//  render is how long the audio it produced lasts; histogram[i] counts the renders that
+//  took between i and i + 1 tenths of it, and the last bin the ones that took longer.
+#pragma mark ____RenderMeterStats
+struct RenderMeterStats {
+	uint32_t	version;						// kRenderMeterVersion
+	uint32_t	kernels;						// entries of kernelNanos in use
+	uint64_t	renders;
+	uint64_t	frames;
+	uint64_t	nanos;							// spent in render, all told
+	uint64_t	maxNanos;						// the slowest render
+	uint64_t	overruns;						// renders that missed their deadline
+	uint64_t	histogram[kRenderMeterBins];
+	uint64_t	kernelNanos[kRenderMeterKernels];
+	uint64_t	lineResets;						// delay lines emptied, snapshot restores aside
+	uint64_t	lineClears;						// delay line chunks zeroed with memset
+};
+
+// one render, as RenderMeterRing streams it
+struct RenderMeterRecord {
+	uint64_t	start;							// host time the render began, in nanoseconds
+	uint32_t	nanos;
+	uint32_t	frames;
+};
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// RenderMeterRing
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// A single producer, single consumer queue of RenderMeterRecords: the render thread pushes
+//  one a render, and one reader on any other thread pops them. Neither side locks or
+//  waits; when the reader falls kCapacity records behind, the newest are dropped and
+//  counted instead.
+#pragma mark ____RenderMeterRing
+class RenderMeterRing {
+	public:
+		static const uint32_t kCapacity = 1024;		// a power of two
+
+		RenderMeterRing () : mWrite (0), mRead (0), mDropped (0) {}
+
+		bool Push (const RenderMeterRecord &inRecord) {
+			uint32_t write = mWrite.load (std::memory_order_relaxed);
+			if (write - mRead.load (std::memory_order_acquire) == kCapacity) {
+				mDropped.store (mDropped.load (std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+				return false;
+			}
+			mRecords[write & (kCapacity - 1)] = inRecord;
+			mWrite.store (write + 1, std::memory_order_release);
+			return true;
+		}
+
+		bool Pop (RenderMeterRecord &outRecord) {
+			uint32_t read = mRead.load (std::memory_order_relaxed);
+			if (read == mWrite.load (std::memory_order_acquire)) return false;
+			outRecord = mRecords[read & (kCapacity - 1)];
+			mRead.store (read + 1, std::memory_order_release);
+			return true;
+		}
+
+		uint64_t Dropped () const {return mDropped.load (std::memory_order_relaxed);}
+
+	private:
+		std::atomic<uint32_t>	mWrite;				// both count up forever and wrap together
+		std::atomic<uint32_t>	mRead;
+		std::atomic<uint64_t>	mDropped;
+		RenderMeterRecord		mRecords[kCapacity];
+};
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// RenderMeter
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Counts renders on the render thread for readers on other threads. Only the render
+//  thread writes the counters, so each is a relaxed load and store, without the locked
+//  read-modify-write an increment from several threads would need; a reader may see one
+//  render counted in some fields and not yet in others.
+//
+// The clock is CAHostTimeBase's host time on macOS and CLOCK_MONOTONIC elsewhere. A
+//  render costs two clock reads, and each kernel timed two more.
+#pragma mark ____RenderMeter
+class RenderMeter {
+	public:
+		RenderMeter () {Reset ();}
+
+		// the clock, in its own ticks
+		static uint64_t Now () {
+#if RENDER_METER_HOST_TIME
+			return CAHostTimeBase::GetTheCurrentTime ();
+#else
+			timespec now;
+			clock_gettime (CLOCK_MONOTONIC, &now);
+			return (uint64_t) now.tv_sec * 1000000000u + now.tv_nsec;
+#endif
+		}
+
+		static uint64_t ToNanos (uint64_t inTicks) {
+#if RENDER_METER_HOST_TIME
+			return CAHostTimeBase::ConvertToNanos (inTicks);
+#else
+			return inTicks;
+#endif
+		}
+
+		// Starts counting again from nothing, as Initialize does. Not meant to overlap a
+		//  render, which could put back part of what it had counted.
+		void Reset () {
+			mRenders.store (0, std::memory_order_relaxed);
+			mFrames.store (0, std::memory_order_relaxed);
+			mNanos.store (0, std::memory_order_relaxed);
+			mMaxNanos.store (0, std::memory_order_relaxed);
+			for (int i = 0; i < kRenderMeterBins; ++i) mHistogram[i].store (0, std::memory_order_relaxed);
+			for (int k = 0; k < kRenderMeterKernels; ++k) mKernelTicks[k].store (0, std::memory_order_relaxed);
+			mKernels.store (0, std::memory_order_relaxed);
+			mLineResets.store (0, std::memory_order_relaxed);
+			mLineClears.store (0, std::memory_order_relaxed);
+		}
+
+		// the render thread's side
+
+		// a render of inFrames frames at inSampleRate that ran from inStart to inEnd
+		void AddRender (uint64_t inStart, uint64_t inEnd, uint32_t inFrames, double inSampleRate) {
+			uint64_t nanos = ToNanos (inEnd - inStart);
+			double deadline = inFrames * 1e9 / inSampleRate;
+			int bin = (deadline > 0) ? (int) (10 * nanos / deadline) : kRenderMeterBins - 1;
+			if (bin > kRenderMeterBins - 1) bin = kRenderMeterBins - 1;
+
+			Add (mRenders, 1);
+			Add (mFrames, inFrames);
+			Add (mNanos, nanos);
+			Add (mHistogram[bin], 1);
+			if (nanos > mMaxNanos.load (std::memory_order_relaxed)) mMaxNanos.store (nanos, std::memory_order_relaxed);
+
+			if (mStreaming.load (std::memory_order_relaxed)) {
+				RenderMeterRecord record = {ToNanos (inStart), (uint32_t) nanos, inFrames};
+				mRing.Push (record);
+			}
+		}
+
+		// the time the inKernel'th kernel took, in ticks of Now
+		void AddKernel (int inKernel, uint64_t inTicks) {
+			if (inKernel >= kRenderMeterKernels) inKernel = kRenderMeterKernels - 1;
+			Add (mKernelTicks[inKernel], inTicks);
+			if (inKernel >= (int) mKernels.load (std::memory_order_relaxed)) mKernels.store (inKernel + 1, std::memory_order_relaxed);
+		}
+
+		// the delay line counts of every kernel, each a running total since Reset
+		void SetLineCounts (uint64_t inResets, uint64_t inClears) {
+			mLineResets.store (inResets, std::memory_order_relaxed);
+			mLineClears.store (inClears, std::memory_order_relaxed);
+		}
+
+		// any thread's side
+
+		void Read (RenderMeterStats &outStats) const {
+			memset (&outStats, 0, sizeof (outStats));
+			outStats.version = kRenderMeterVersion;
+			outStats.kernels = mKernels.load (std::memory_order_relaxed);
+			outStats.renders = mRenders.load (std::memory_order_relaxed);
+			outStats.frames = mFrames.load (std::memory_order_relaxed);
+			outStats.nanos = mNanos.load (std::memory_order_relaxed);
+			outStats.maxNanos = mMaxNanos.load (std::memory_order_relaxed);
+			for (int i = 0; i < kRenderMeterBins; ++i) outStats.histogram[i] = mHistogram[i].load (std::memory_order_relaxed);
+			outStats.overruns = outStats.histogram[kRenderMeterBins - 1];
+			for (int k = 0; k < kRenderMeterKernels; ++k) outStats.kernelNanos[k] = ToNanos (mKernelTicks[k].load (std::memory_order_relaxed));
+			outStats.lineResets = mLineResets.load (std::memory_order_relaxed);
+			outStats.lineClears = mLineClears.load (std::memory_order_relaxed);
+		}
+
+		// The ring every later render pushes a record into; nothing is pushed until the
+		//  first call. The ring lives as long as the meter, and takes one reader.
+		RenderMeterRing *StartStreaming () {
+			mStreaming.store (true, std::memory_order_relaxed);
+			return &mRing;
+		}
+
+	private:
+		RenderMeter (const RenderMeter &);
+		RenderMeter &operator= (const RenderMeter &);
+
+		static void Add (std::atomic<uint64_t> &ioCounter, uint64_t inAmount) {
+			ioCounter.store (ioCounter.load (std::memory_order_relaxed) + inAmount, std::memory_order_relaxed);
+		}
+
+		std::atomic<uint64_t>	mRenders;
+		std::atomic<uint64_t>	mFrames;
+		std::atomic<uint64_t>	mNanos;
+		std::atomic<uint64_t>	mMaxNanos;
+		std::atomic<uint64_t>	mHistogram[kRenderMeterBins];
+		std::atomic<uint64_t>	mKernelTicks[kRenderMeterKernels];
+		std::atomic<uint32_t>	mKernels;
+		std::atomic<uint64_t>	mLineResets;
+		std::atomic<uint64_t>	mLineClears;
+		std::atomic<bool>		mStreaming {false};
+		RenderMeterRing			mRing;
+};
+
+#endif
@@ -10,12 +10,13 @@ Filter Effect AU
 #include <AudioToolbox/AudioUnitUtilities.h>
 #include "FilterVersion.h"
 #include "Filter.h"
-#include <math.h>
+#include "FilterCore.h"
+#include "RenderMeter.h"
 
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 #pragma mark ____FilterKernel
 
-class FilterKernel : public AUKernelBase		// the actual filter DSP happens here
+class FilterKernel : public AUKernelBase		// runs the filter DSP in FilterCore
 {
 public:
 	FilterKernel(AUEffectBase *inAudioUnit );
@@ -31,39 +32,19 @@ public:
 	// resets the filter state
 	virtual void		Reset();
 
-	void				CalculateLopassParams(	double inFreq, double inResonance );
+	// sizes the comb for inSampleRate, see Filter::Initialize
+	bool				Allocate( double inSampleRate ) { return mCore.Allocate(inSampleRate); }
 
-	// used by the custom property handled in the Filter class below
-	double				GetFrequencyResponse( double inFreq );
+	// for Filter::ProcessBufferLists, which runs the comb of each kernel itself
+	FilterCore &		Core() { return mCore; }
 	
+	// where Process adds its time, as the inSlot'th kernel
+	void				SetMeter( RenderMeter *inMeter, int inSlot ) { mMeter = inMeter; mMeterSlot = inSlot; }
 			
 private:
-	// filter coefficients
-	double	mA0;
-	double	mA1;
-	double	mA2;
-	double	mB1;
-	double	mB2;
-
-	// filter state
-	double	mX1;
-	double	mX2;
-	double	mY1;
-	double	mY2;
-	
-	double	mLastCutoff;
-	double	mLastResonance;
-//    int nSamples = 0;
-//    int length = GetSampleRate()/2;
-    //    int cycle = 0;
-    const static int t = 512;
-    const static int maxDelay = t*512;
-    Float32 lastDelay [maxDelay] = { };
-//    const static int maxDelay = t*512;
-    //    Float32 fbk = 0.75;
-    int head = 0;
-    int rate = t;
-    float fbk = 0.4;
+	FilterCore	mCore;
+	RenderMeter	*mMeter = NULL;
+	int			mMeterSlot = 0;
 };
 
 
@@ -79,8 +60,33 @@ public:
 
 	virtual OSStatus			Initialize();
 
+	// resets the kernels and the linked lowpass
+	virtual OSStatus			Reset(	AudioUnitScope			inScope,
+										AudioUnitElement		inElement );
+
 	virtual AUKernelBase *		NewKernel() { return new FilterKernel(this); }
 
+	// runs every channel's lowpass in one BiquadCascade when the channels are linked
+	virtual OSStatus			ProcessBufferLists(	AudioUnitRenderActionFlags &	ioActionFlags,
+													const AudioBufferList &			inBuffer,
+													AudioBufferList &				outBuffer,
+													UInt32							inFramesToProcess );
+
+	// renders with flush-to-zero on, see Denormals.h, and counts the time in mRenderMeter
+	virtual OSStatus			Render(	AudioUnitRenderActionFlags &	ioActionFlags,
+										const AudioTimeStamp &			inTimeStamp,
+										UInt32							inFramesToProcess )
+	{
+		uint64_t start = RenderMeter::Now();
+		OSStatus result;
+		{
+			DenormalGuard denormalGuard;
+			result = AUEffectBase::Render(ioActionFlags, inTimeStamp, inFramesToProcess);
+		}
+		mRenderMeter.AddRender(start, RenderMeter::Now(), inFramesToProcess, GetSampleRate());
+		return result;
+	}
+
 	// for custom property
 	virtual OSStatus			GetPropertyInfo(	AudioUnitPropertyID		inID,
 													AudioUnitScope			inScope,
@@ -115,6 +121,15 @@ public:
 
 
 protected:
+	RenderMeter					mRenderMeter;		// see kAudioUnitCustomProperty_FilterRenderMeter
+
+	// Float32 streams of 2 to BiquadCascade::kMaxLanes channels are linked: each kernel
+	// still runs its own comb, then mLinkedLopass runs the lowpass on all of them at once
+	int							mLinkedChannels;
+	BiquadCascade				mLinkedLopass;
+
+	// answers kAudioUnitCustomProperty_FilterFrequencyResponse, which views poll
+	LopassResponse				mResponse;
 };
 
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -126,23 +141,20 @@ AUDIOCOMPONENT_ENTRY(AUBaseProcessFactory, Filter)
 enum
 {
 	kFilterParam_CutoffFrequency = 0,
-	kFilterParam_Resonance = 1
+	kFilterParam_Resonance = 1,
+	kFilterParam_Sections = 2,
+	kFilterParam_Smoothing = 3
 };
 
 //static const int nMax = 2*maxDelay;
 
 static CFStringRef kCutoffFreq_Name = CFSTR("cutoff frequency");
 static CFStringRef kResonance_Name = CFSTR("resonance");
+static CFStringRef kSections_Name = CFSTR("lowpass sections");
+static CFStringRef kSmoothing_Name = CFSTR("lowpass smoothing");
 
-// cutoff ~ delay time (samples)
-const int kMinCutoffHz = 16;
-const int kMaxCuttofHz = 512*512;
-const int kDefaultCutoff = 512;
-
-// resonance ~ feedback (float)
-const float kMinResonance = 0.0;
-const float kMaxResonance = 1.0;
-const float kDefaultResonance = 0;
+// the ranges of cutoff (~ delay time in samples), resonance (~ feedback), the lowpass
+// sections and its smoothing are in FilterCore.h
 
 // Factory presets
 static const int kPreset_One = 0;
@@ -167,7 +179,7 @@ static AUPreset kPresets[kNumberPresets] =
 //
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 Filter::Filter(AudioUnit component)
-	: AUEffectBase(component)
+	: AUEffectBase(component), mLinkedChannels(0)
 {
 	// all the parameters must be set to their initial values here
 	//
@@ -176,6 +188,8 @@ Filter::Filter(AudioUnit component)
 	//
 	SetParameter(kFilterParam_CutoffFrequency, kDefaultCutoff);
 	SetParameter(kFilterParam_Resonance, kDefaultResonance);
+	SetParameter(kFilterParam_Sections, kDefaultSections);
+	SetParameter(kFilterParam_Smoothing, kDefaultSmoothing);
 
 	// kFilterParam_CutoffFrequency max value depends on sample-rate
 	SetParamHasSampleRateDependency(true);
@@ -194,11 +208,91 @@ OSStatus			Filter::Initialize()
 		// in case the AU was un-initialized and parameters were changed, the view can now
 		// be made aware it needs to update the frequency response curve
 		PropertyChanged(kAudioUnitCustomProperty_FilterFrequencyResponse, kAudioUnitScope_Global, 0 );
+
+		// the kernels outlive a change of sample rate while uninitialized, so their
+		// combs are sized here rather than when they're built
+		mLinkedChannels = 0;
+		if (mKernelList.size() >= 2 && mKernelList.size() <= (size_t) BiquadCascade::kMaxLanes
+			&& GetCommonPCMFormat() == CAStreamBasicDescription::kPCMFormatFloat32)
+			mLinkedChannels = (int) mKernelList.size();
+		mLinkedLopass.Reset();
+
+		mRenderMeter.Reset();
+		for (size_t i = 0; i < mKernelList.size(); ++i)
+		{
+			FilterKernel *filterKernel = static_cast<FilterKernel*>(mKernelList[i]);
+			if (filterKernel == NULL) continue;
+			if (!filterKernel->Allocate(GetSampleRate())) return kAudio_MemFullError;
+			filterKernel->SetMeter(&mRenderMeter, (int) i);
+		}
 	}
 	
 	return result;
 }
 
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	Filter::Reset
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+OSStatus			Filter::Reset(	AudioUnitScope			inScope,
+									AudioUnitElement		inElement )
+{
+	mLinkedLopass.Reset();
+	return AUEffectBase::Reset(inScope, inElement);
+}
+
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#pragma mark ____Rendering
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	Filter::ProcessBufferLists
+//
+//		Linked channels run their combs in their own kernels, with the lowpass left
+//		out, and then go through mLinkedLopass together, a vector for all of them.
+//		Silence is flagged as AUEffectBase::ProcessBufferListsT flags it.
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+OSStatus			Filter::ProcessBufferLists(	AudioUnitRenderActionFlags &	ioActionFlags,
+												const AudioBufferList &			inBuffer,
+												AudioBufferList &				outBuffer,
+												UInt32							inFramesToProcess )
+{
+	if (mLinkedChannels == 0 || ShouldBypassEffect()
+		|| inBuffer.mNumberBuffers != (UInt32) mLinkedChannels || outBuffer.mNumberBuffers != (UInt32) mLinkedChannels)
+		return AUEffectBase::ProcessBufferLists(ioActionFlags, inBuffer, outBuffer, inFramesToProcess);
+
+	bool silentInput = IsInputSilent(ioActionFlags, inFramesToProcess);
+	ioActionFlags |= kAudioUnitRenderAction_OutputIsSilence;
+
+	int cutoff = GetParameter(kFilterParam_CutoffFrequency);
+	float resonance = GetParameter(kFilterParam_Resonance);
+	int sections = GetParameter(kFilterParam_Sections);
+	bool smoothing = GetParameter(kFilterParam_Smoothing) != 0;
+
+	const float *sources[BiquadCascade::kMaxLanes];
+	float *dests[BiquadCascade::kMaxLanes];
+	for (int c = 0; c < mLinkedChannels; ++c)
+	{
+		sources[c] = (const float *) inBuffer.mBuffers[c].mData;
+		dests[c] = (float *) outBuffer.mBuffers[c].mData;
+
+		uint64_t start = RenderMeter::Now();
+		static_cast<FilterKernel*>(mKernelList[c])->Core().Process(sources[c], dests[c], inFramesToProcess, cutoff, resonance, 0, smoothing);
+		mRenderMeter.AddKernel(c, RenderMeter::Now() - start);
+	}
+
+	// the first core has worked out the coefficients for this buffer; they only ramp
+	// when they've changed
+	uint64_t start = RenderMeter::Now();
+	FilterCore &core = static_cast<FilterKernel*>(mKernelList[0])->Core();
+	mLinkedLopass.SetSections(sections);
+	mLinkedLopass.SetCoefficients(core.LopassCoefficients(), smoothing);
+	mLinkedLopass.ProcessChannels(dests, dests, mLinkedChannels, inFramesToProcess);
+	mRenderMeter.AddKernel(0, RenderMeter::Now() - start);
+
+	if (!silentInput) ioActionFlags &= ~kAudioUnitRenderAction_OutputIsSilence;
+	return noErr;
+}
 
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 #pragma mark ____Parameters
@@ -238,6 +332,22 @@ OSStatus			Filter::GetParameterInfo(	AudioUnitScope			inScope,
 				outParameterInfo.defaultValue = kDefaultResonance;
 				outParameterInfo.flags += kAudioUnitParameterFlag_IsHighResolution;
 				break;
+
+			case kFilterParam_Sections:
+				AUBase::FillInParameterName (outParameterInfo, kSections_Name, false);
+				outParameterInfo.unit = kAudioUnitParameterUnit_Indexed;
+				outParameterInfo.minValue = kMinSections;
+				outParameterInfo.maxValue = kMaxSections;
+				outParameterInfo.defaultValue = kDefaultSections;
+				break;
+
+			case kFilterParam_Smoothing:
+				AUBase::FillInParameterName (outParameterInfo, kSmoothing_Name, false);
+				outParameterInfo.unit = kAudioUnitParameterUnit_Boolean;
+				outParameterInfo.minValue = 0;
+				outParameterInfo.maxValue = 1;
+				outParameterInfo.defaultValue = kDefaultSmoothing;
+				break;
 				
 			default:
 				result = kAudioUnitErr_InvalidParameter;
@@ -277,6 +387,16 @@ OSStatus			Filter::GetPropertyInfo (	AudioUnitPropertyID				inID,
 				outDataSize = kNumberOfResponseFrequencies * sizeof(FrequencyResponse);
 				outWritable = false;
 				return noErr;
+
+			case kAudioUnitCustomProperty_FilterRenderMeter:
+				outDataSize = sizeof(RenderMeterStats);
+				outWritable = false;
+				return noErr;
+
+			case kAudioUnitCustomProperty_FilterRenderMeterRing:
+				outDataSize = sizeof(RenderMeterRing *);
+				outWritable = false;
+				return noErr;
 		}
 	}
 	
@@ -326,39 +446,34 @@ OSStatus			Filter::GetProperty (	AudioUnitPropertyID 		inID,
 			{
 				if(inScope != kAudioUnitScope_Global) 	return kAudioUnitErr_InvalidScope;
 
-				// the kernels are only created if we are initialized
-				// since we're using the kernels to get the curve info, let
-				// the caller know we can't do it if we're un-initialized
+				// the sample rate is only settled once we're initialized, so let the
+				// caller know we can't do it if we're un-initialized
 				// the UI should check for the error and not draw the curve in this case
 				if(!IsInitialized() ) return kAudioUnitErr_Uninitialized;
 
 				FrequencyResponse *freqResponseTable = ((FrequencyResponse*)outData);
 
-				// each of our filter kernel objects (one per channel) will have an identical frequency response
-				// so we arbitrarilly use the first one...
-				//
-				FilterKernel *filterKernel = dynamic_cast<FilterKernel*>(mKernelList[0]);
-
-
 				int cutoff = GetParameter(kFilterParam_CutoffFrequency);
-				int resonance = GetParameter(kFilterParam_Resonance );
-
-//				float srate = GetSampleRate();
-				
-//				cutoff = 2.0 * cutoff / srate;
-//				if(cutoff > 0.99) cutoff = 0.99;		// clip cutoff to highest allowed by sample rate...
+				float resonance = GetParameter(kFilterParam_Resonance );
+				int sections = GetParameter(kFilterParam_Sections);
 
-				filterKernel->CalculateLopassParams(cutoff, resonance);
-				
-				for(int i = 0; i < kNumberOfResponseFrequencies; i++ )
-				{
-					double frequency = freqResponseTable[i].mFrequency;
-					
-					freqResponseTable[i].mMagnitude = filterKernel->GetFrequencyResponse(frequency);
-				}
+				// every kernel has the same response, so mResponse works it out from the
+				// parameters without touching theirs, and only when they, the sample rate
+				// or the frequencies asked for have changed
+				mResponse.Evaluate(	&freqResponseTable[0].mFrequency, &freqResponseTable[0].mMagnitude,
+									sizeof(FrequencyResponse) / sizeof(Float64), kNumberOfResponseFrequencies,
+									GetSampleRate(), cutoff, resonance, sections );
 
 				return noErr;
 			}
+
+			case kAudioUnitCustomProperty_FilterRenderMeter:
+				mRenderMeter.Read(*(RenderMeterStats *) outData);
+				return noErr;
+
+			case kAudioUnitCustomProperty_FilterRenderMeterRing:
+				*(RenderMeterRing **) outData = mRenderMeter.StartStreaming();
+				return noErr;
 		}
 	}
 	
@@ -436,9 +551,8 @@ OSStatus	Filter::NewFactoryPresetSet (const AUPreset & inNewFactoryPreset)
 //
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 FilterKernel::FilterKernel(AUEffectBase *inAudioUnit )
-	: AUKernelBase(inAudioUnit)
+	: AUKernelBase(inAudioUnit), mCore(GetSampleRate())
 {
-	Reset();
 }
 
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -453,92 +567,17 @@ FilterKernel::~FilterKernel( )
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 //	FilterKernel::Reset()
 //
-//		It's very important to fully reset all filter state variables to their
-//		initial settings here.  For delay/reverb effects, the delay buffers must
-//		also be cleared here.
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 void		FilterKernel::Reset()
 {
-	mX1 = 0.0;
-	mX2 = 0.0;
-	mY1 = 0.0;
-	mY2 = 0.0;
-	
-	// forces filter coefficient calculation
-	mLastCutoff = -1.0;
-	mLastResonance = -1.0;
-//    nSamples = 0;
-    for (int i = 0; i < t; i++) {
-//        for(int j = i; j < t; j++) {
-//            lastDelay[i][j] = 0;
-//        }
-        lastDelay[i] = 0;
-    }
-}
-
-//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-//	FilterKernel::CalculateLopassParams()
-//
-//		inFreq is normalized frequency 0 -> 1
-//		inResonance is in decibels
-//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-void FilterKernel::CalculateLopassParams(	double inFreq,
-											double inResonance )
-{
-    double r = pow(10.0, 0.05 * -inResonance);		// convert from decibels to linear
-    
-    double k = 0.5 * r * sin(M_PI * inFreq);
-    double c1 = 0.5 * (1.0 - k) / (1.0 + k);
-    double c2 = (0.5 + c1) * cos(M_PI * inFreq);
-    double c3 = (0.5 + c1 - c2) * 0.25;
-    
-    mA0 = 2.0 *   c3;
-    mA1 = 2.0 *   2.0 * c3;
-    mA2 = 2.0 *   c3;
-    mB1 = 2.0 *   -c2;
-    mB2 = 2.0 *   c1;
-}
-
-//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-//	FilterKernel::GetFrequencyResponse()
-//
-//		returns scalar magnitude response
-//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-double FilterKernel::GetFrequencyResponse( double inFreq /* in Hertz */ )
-{
-	float srate = GetSampleRate();
-	
-	double scaledFrequency = 2.0 * inFreq / srate;
-	
-	// frequency on unit circle in z-plane
-	double zr = cos(M_PI * scaledFrequency);
-	double zi = sin(M_PI * scaledFrequency);
-	
-	// zeros response
-	double num_r = mA0*(zr*zr - zi*zi) + mA1*zr + mA2;
-	double num_i = 2.0*mA0*zr*zi + mA1*zi;
-	
-	double num_mag = sqrt(num_r*num_r + num_i*num_i);
-	
-	// poles response
-	double den_r = zr*zr - zi*zi + mB1*zr + mB2;
-	double den_i = 2.0*zr*zi + mB1*zi;
-	
-	double den_mag = sqrt(den_r*den_r + den_i*den_i);
-	
-	// total response
-	double response = num_mag  / den_mag;
-
-	
-	return response;
+	mCore.Reset();
 }
 
-
-
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 //	FilterKernel::Process(int inFramesToProcess)
 //
-//		We process one non-interleaved stream at a time
+//		We process one non-interleaved stream at a time; FilterCore bounds checks the
+//		parameters
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 void FilterKernel::Process(	const Float32 	*inSourceP,
 							Float32 		*inDestP,
@@ -546,54 +585,12 @@ void FilterKernel::Process(	const Float32 	*inSourceP,
 							UInt32			inNumChannels,	// for version 2 AudioUnits inNumChannels is always 1
 							bool &			ioSilence)
 {
-    
 	int cutoff = GetParameter(kFilterParam_CutoffFrequency);
     float resonance = GetParameter(kFilterParam_Resonance );
+	int sections = GetParameter(kFilterParam_Sections);
+	bool smoothing = GetParameter(kFilterParam_Smoothing) != 0;
     
-	// do bounds checking on parameters
-	//
-    if(cutoff < kMinCutoffHz) cutoff = kMinCutoffHz;
-
-	if(resonance < kMinResonance ) resonance = kMinResonance;
-	if(resonance > kMaxResonance ) resonance = kMaxResonance;
-
-	
-	// convert to 0->1 normalized frequency
-//	float srate = GetSampleRate();
-    
-	
-//	cutoff = 2.0 * cutoff / srate;
-//	if(cutoff > 0.99) cutoff = 0.99;		// clip cutoff to highest allowed by sample rate...
-    
-	// only calculate the filter coefficients if the parameters have changed from last time
-	if(cutoff != mLastCutoff || resonance != mLastResonance )
-	{
-		CalculateLopassParams(cutoff, resonance);
-        if (cutoff > mLastCutoff) {
-            rate = cutoff*t;
-            mLastCutoff = cutoff;
-        } else if (cutoff < mLastCutoff) {
-            if (head < cutoff) {
-                rate = cutoff*t;
-            }
-            mLastCutoff = cutoff;
-        }
-        if (resonance != mLastResonance) {
-            fbk = resonance;
-            mLastResonance = resonance;
-        }
-	}
-
-    const Float32 *sourceP = inSourceP;
-    Float32 *destP = inDestP;
-    int n = inFramesToProcess;
-    Float32 mix = 0.6;
-	
-	// Apply the filter on the input and write to the output
-	// This code isn't optimized and is written for clarity...
-    while(n--) {
-        lastDelay[rate-head] = *sourceP + fbk*lastDelay[rate-head];
-        head = (head+1) % rate;
-        *destP++ = mix*(lastDelay[head] + *sourceP++);
-	}
+	uint64_t start = RenderMeter::Now();
+	mCore.Process(inSourceP, inDestP, inFramesToProcess, cutoff, resonance, sections, smoothing);
+	if (mMeter != NULL) mMeter->AddKernel(mMeterSlot, RenderMeter::Now() - start);
 }
@@ -18,7 +18,13 @@ Filter Effect AU
 //
 enum
 {
-	kAudioUnitCustomProperty_FilterFrequencyResponse = 65536
+	kAudioUnitCustomProperty_FilterFrequencyResponse = 65536,
+
+	// what the renders cost, as a RenderMeterStats (see Shared/RenderMeter.h); read-only
+	kAudioUnitCustomProperty_FilterRenderMeter = 65537,
+
+	// a RenderMeterRing * streaming one record a render from the first get on; read-only
+	kAudioUnitCustomProperty_FilterRenderMeterRing = 65538
 };
 
 // We'll define our property data to be a size kNumberOfResponseFrequencies array of structs
@@ -0,0 +1,1100 @@
+/*
+Copyright (C) 2016 Apple Inc. All Rights Reserved.
+See LICENSE.txt for this sample’s licensing information
+
+Abstract:
+Filter Effect DSP, shared by the AU and the offline tools
+*/
+
+#include "FilterCore.h"
+
+#if defined(__SSE__) || defined(__x86_64__) || defined(_M_X64)
+	#include <xmmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	#include <arm_neon.h>
+#endif
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#pragma mark ____Comb Runs
+
+// Samples the comb works on at once. The inner loops run over exactly this many, and
+//  compute into a local block before storing any of it, so the compiler turns each into a
+//  few vector instructions without having to prove the buffers don't overlap.
+static const int kCombVector = 8;
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	FeedComb()
+//
+//		The feedback writes of inFrames samples. The write index falls by one a sample,
+//		so source sample j goes into ioTap[-j]; every tap is a different index.
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+static inline void FeedComb( float *ioTap, const float *inSourceP, long inFrames, float inFeedback )
+{
+	long j = 0;
+	for ( ; j + kCombVector <= inFrames; j += kCombVector)
+	{
+		float *taps = ioTap - j - (kCombVector - 1);		// the block's taps, lowest index first
+		float fed[kCombVector];
+		for (int k = 0; k < kCombVector; ++k) fed[k] = ScrubDenormal(inSourceP[j + kCombVector - 1 - k] + inFeedback*taps[k]);
+		for (int k = 0; k < kCombVector; ++k) taps[k] = fed[k];
+	}
+	for ( ; j < inFrames; ++j) ioTap[-j] = ScrubDenormal(inSourceP[j] + inFeedback*ioTap[-j]);
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	MixComb()
+//
+//		The output of inFrames samples, reading the line upwards from inTaps
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+static inline void MixComb( float *outDestP, const float *inTaps, const float *inSourceP, long inFrames, float inMix )
+{
+	long j = 0;
+	for ( ; j + kCombVector <= inFrames; j += kCombVector)
+	{
+		float mixed[kCombVector];
+		for (int k = 0; k < kCombVector; ++k) mixed[k] = inMix*(inTaps[j + k] + inSourceP[j + k]);
+		for (int k = 0; k < kCombVector; ++k) outDestP[j + k] = mixed[k];
+	}
+	for ( ; j < inFrames; ++j) outDestP[j] = inMix*(inTaps[j] + inSourceP[j]);
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#pragma mark ____Vectors
+
+// Four floats and the few operations the lowpass needs on them: SSE on x86, NEON on ARM,
+//  plain floats elsewhere. The compiler's own vectorizing of the lowpass went through
+//  the stack on every step, and the stalls that caused cost more than the vectors saved.
+#if defined(__SSE__) || defined(__x86_64__) || defined(_M_X64)
+	typedef __m128 Vec4;
+
+	static inline Vec4 VecSplat( float inValue ) { return _mm_set1_ps(inValue); }
+	static inline Vec4 VecSet( float inA, float inB, float inC, float inD ) { return _mm_setr_ps(inA, inB, inC, inD); }
+	static inline Vec4 VecLoad( const float *inP ) { return _mm_loadu_ps(inP); }
+	static inline void VecStore( float *outP, Vec4 inV ) { _mm_storeu_ps(outP, inV); }
+	static inline Vec4 VecAdd( Vec4 inA, Vec4 inB ) { return _mm_add_ps(inA, inB); }
+	static inline Vec4 VecSub( Vec4 inA, Vec4 inB ) { return _mm_sub_ps(inA, inB); }
+	static inline Vec4 VecMul( Vec4 inA, Vec4 inB ) { return _mm_mul_ps(inA, inB); }
+
+	// { inBelow[3], inV[0], inV[1], inV[2] }
+	static inline Vec4 VecShiftIn( Vec4 inV, Vec4 inBelow )
+	{
+		Vec4 edge = _mm_shuffle_ps(inBelow, inV, _MM_SHUFFLE(0, 0, 3, 3));
+		return _mm_shuffle_ps(edge, inV, _MM_SHUFFLE(2, 1, 2, 0));
+	}
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	typedef float32x4_t Vec4;
+
+	static inline Vec4 VecSplat( float inValue ) { return vdupq_n_f32(inValue); }
+	static inline Vec4 VecSet( float inA, float inB, float inC, float inD )
+	{
+		float values[4] = { inA, inB, inC, inD };
+		return vld1q_f32(values);
+	}
+	static inline Vec4 VecLoad( const float *inP ) { return vld1q_f32(inP); }
+	static inline void VecStore( float *outP, Vec4 inV ) { vst1q_f32(outP, inV); }
+	static inline Vec4 VecAdd( Vec4 inA, Vec4 inB ) { return vaddq_f32(inA, inB); }
+	static inline Vec4 VecSub( Vec4 inA, Vec4 inB ) { return vsubq_f32(inA, inB); }
+	static inline Vec4 VecMul( Vec4 inA, Vec4 inB ) { return vmulq_f32(inA, inB); }
+
+	static inline Vec4 VecShiftIn( Vec4 inV, Vec4 inBelow ) { return vextq_f32(inBelow, inV, 3); }
+#else
+	struct Vec4 { float f[4]; };
+
+	static inline Vec4 VecSplat( float inValue ) { Vec4 v = {{ inValue, inValue, inValue, inValue }}; return v; }
+	static inline Vec4 VecSet( float inA, float inB, float inC, float inD ) { Vec4 v = {{ inA, inB, inC, inD }}; return v; }
+	static inline Vec4 VecLoad( const float *inP ) { Vec4 v; memcpy(v.f, inP, sizeof(v.f)); return v; }
+	static inline void VecStore( float *outP, Vec4 inV ) { memcpy(outP, inV.f, sizeof(inV.f)); }
+	static inline Vec4 VecAdd( Vec4 inA, Vec4 inB ) { for (int i = 0; i < 4; ++i) inA.f[i] += inB.f[i]; return inA; }
+	static inline Vec4 VecSub( Vec4 inA, Vec4 inB ) { for (int i = 0; i < 4; ++i) inA.f[i] -= inB.f[i]; return inA; }
+	static inline Vec4 VecMul( Vec4 inA, Vec4 inB ) { for (int i = 0; i < 4; ++i) inA.f[i] *= inB.f[i]; return inA; }
+
+	static inline Vec4 VecShiftIn( Vec4 inV, Vec4 inBelow )
+	{
+		Vec4 v = {{ inBelow.f[3], inV.f[0], inV.f[1], inV.f[2] }};
+		return v;
+	}
+#endif
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#pragma mark ____BiquadCascade
+
+// Every path evaluates a section the same way, term for term:
+//
+//		y = a0*x + z1		z1 = a1*x + z2 - b1*y		z2 = a2*x - b2*y
+//
+// which keeps one multiply and one add between y and the next y's z1, rather than the two
+//  adds of a1*x - b1*y + z2.
+
+struct VecCoefficients {
+	Vec4	a0, a1, a2;
+	Vec4	b1, b2;
+};
+
+static inline VecCoefficients VecSplat( const BiquadCoefficients &inK )
+{
+	VecCoefficients k = { VecSplat(inK.a0), VecSplat(inK.a1), VecSplat(inK.a2), VecSplat(inK.b1), VecSplat(inK.b2) };
+	return k;
+}
+
+// one section on four frames or channels at once, giving back y
+static inline Vec4 VecSection( const VecCoefficients &inK, Vec4 inX, Vec4 &ioZ1, Vec4 &ioZ2 )
+{
+	Vec4 y = VecAdd(VecMul(inK.a0, inX), ioZ1);
+	ioZ1 = VecSub(VecAdd(VecMul(inK.a1, inX), ioZ2), VecMul(inK.b1, y));
+	ioZ2 = VecSub(VecMul(inK.a2, inX), VecMul(inK.b2, y));
+	return y;
+}
+
+// The coefficients of one buffer: frame i runs with from + (i + 1) * step when it ramps,
+//  and with from when it doesn't. The vector paths work out the ramp with the same two
+//  operations as the serial one, so they get the same coefficients for a frame.
+struct CoefficientRamp {
+	BiquadCoefficients	from;
+	BiquadCoefficients	step;
+};
+
+static inline CoefficientRamp MakeRamp( const BiquadCoefficients &inFrom, const BiquadCoefficients &inTo, int inFrames )
+{
+	float frames = (float)inFrames;
+	CoefficientRamp ramp = { inFrom, { (inTo.a0 - inFrom.a0) / frames, (inTo.a1 - inFrom.a1) / frames,
+										(inTo.a2 - inFrom.a2) / frames, (inTo.b1 - inFrom.b1) / frames,
+										(inTo.b2 - inFrom.b2) / frames } };
+	return ramp;
+}
+
+template <bool Ramp>
+static inline BiquadCoefficients RampAt( const CoefficientRamp &inRamp, int inFrame )
+{
+	if (!Ramp) return inRamp.from;
+
+	float i = (float)(inFrame + 1);
+	const BiquadCoefficients &from = inRamp.from, &step = inRamp.step;
+	BiquadCoefficients k = { from.a0 + i*step.a0, from.a1 + i*step.a1, from.a2 + i*step.a2,
+								from.b1 + i*step.b1, from.b2 + i*step.b2 };
+	return k;
+}
+
+// RampAt for four frames, inNext holding i + 1 of each
+static inline VecCoefficients VecRampAt( const VecCoefficients &inFrom, const VecCoefficients &inStep, Vec4 inNext )
+{
+	VecCoefficients k = {	VecAdd(inFrom.a0, VecMul(inNext, inStep.a0)), VecAdd(inFrom.a1, VecMul(inNext, inStep.a1)),
+							VecAdd(inFrom.a2, VecMul(inNext, inStep.a2)), VecAdd(inFrom.b1, VecMul(inNext, inStep.b1)),
+							VecAdd(inFrom.b2, VecMul(inNext, inStep.b2)) };
+	return k;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	StepSections()
+//
+//		Step inStep of BiquadCascade::ProcessSteps while it fills or drains: every one
+//		of the Width sections takes its inX and gives its outY, but only inFirst to
+//		inLast keep their new state; the others have no frame to work on in this step.
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+template <int Width, bool Ramp>
+static inline void StepSections(	const float					*inX,
+									float						*outY,
+									float						*ioZ1,
+									float						*ioZ2,
+									const CoefficientRamp		&inRamp,
+									int							inStep,
+									int							inFirst,
+									int							inLast )
+{
+	for (int s = 0; s < Width; ++s)
+	{
+		BiquadCoefficients k = RampAt<Ramp>(inRamp, inStep - s);
+		float y = k.a0*inX[s] + ioZ1[s];
+		if (s >= inFirst && s <= inLast)
+		{
+			ioZ1[s] = k.a1*inX[s] + ioZ2[s] - k.b1*y;
+			ioZ2[s] = k.a2*inX[s] - k.b2*y;
+		}
+		outY[s] = y;
+	}
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	BiquadCascade::BiquadCascade()
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+BiquadCascade::BiquadCascade()
+	: mSections(0)
+{
+	BiquadCoefficients through = { 1, 0, 0, 0, 0 };
+	mCoefficients = mRampFrom = through;
+	Reset();
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	BiquadCascade::Reset()
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void		BiquadCascade::Reset()
+{
+	memset(mZ1, 0, sizeof(mZ1));
+	memset(mZ2, 0, sizeof(mZ2));
+	mRamping = false;
+	mStarted = false;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	BiquadCascade::SetSections()
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void		BiquadCascade::SetSections( int inSections )
+{
+	if (inSections < 0) inSections = 0;
+	if (inSections > kMaxSections) inSections = kMaxSections;
+
+	for (int s = inSections; s < kMaxSections; ++s)
+	{
+		for (int c = 0; c < kMaxLanes; ++c) mZ1[s][c] = mZ2[s][c] = 0;
+	}
+	mSections = inSections;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	BiquadCascade::SetCoefficients()
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void		BiquadCascade::SetCoefficients( const BiquadCoefficients &inCoefficients, bool inRamp )
+{
+	if (!inRamp || !mStarted) mRamping = false;
+	else if (!mRamping)
+	{
+		mRampFrom = mCoefficients;
+		mRamping = true;
+	}
+	mCoefficients = inCoefficients;
+	mStarted = true;
+
+	const BiquadCoefficients &from = mRampFrom, &to = mCoefficients;
+	if (from.a0 == to.a0 && from.a1 == to.a1 && from.a2 == to.a2 && from.b1 == to.b1 && from.b2 == to.b2)
+		mRamping = false;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	BiquadCascade::ProcessSerial()
+//
+//		One section after the other, for a single section or a buffer too short to
+//		fill the steps of ProcessSteps
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+template <bool Ramp>
+void		BiquadCascade::ProcessSerial( const float *inSourceP, float *inDestP, int inFramesToProcess )
+{
+	const CoefficientRamp ramp = MakeRamp(Ramp ? mRampFrom : mCoefficients, mCoefficients, inFramesToProcess);
+	int n = mSections;
+
+	float z1[kMaxSections], z2[kMaxSections];
+	for (int s = 0; s < n; ++s)
+	{
+		z1[s] = mZ1[s][0];
+		z2[s] = mZ2[s][0];
+	}
+
+	for (int i = 0; i < inFramesToProcess; ++i)
+	{
+		const BiquadCoefficients k = RampAt<Ramp>(ramp, i);
+		float x = inSourceP[i];
+		for (int s = 0; s < n; ++s)
+		{
+			float y = k.a0*x + z1[s];
+			z1[s] = k.a1*x + z2[s] - k.b1*y;
+			z2[s] = k.a2*x - k.b2*y;
+			x = y;
+		}
+		inDestP[i] = x;
+	}
+
+	for (int s = 0; s < n; ++s)
+	{
+		mZ1[s][0] = ScrubDenormal(z1[s]);
+		mZ2[s][0] = ScrubDenormal(z2[s]);
+	}
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	BiquadCascade::ProcessSteps()
+//
+//		Step t hands frame t to section 0 and each section's last output on to the next,
+//		so section s works on frame t - s, and the sections sit side by side in Vectors
+//		Vec4s. Only the first and last mSections - 1 steps have sections with no frame
+//		yet, or none left; they go through StepSections. Sections past mSections
+//		compute too, on what the last one gives them, and are never read. When the
+//		coefficients ramp, each lane works out its own for the frame it's on.
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+template <int Vectors, bool Ramp>
+void		BiquadCascade::ProcessSteps( const float *inSourceP, float *inDestP, int inFramesToProcess )
+{
+	const int kWidth = 4 * Vectors;
+	const CoefficientRamp ramp = MakeRamp(Ramp ? mRampFrom : mCoefficients, mCoefficients, inFramesToProcess);
+	int n = mSections;
+	int frames = inFramesToProcess;
+
+	float z1[kWidth], z2[kWidth], x[kWidth], y[kWidth];
+	for (int s = 0; s < kWidth; ++s)
+	{
+		z1[s] = (s < n) ? mZ1[s][0] : 0;
+		z2[s] = (s < n) ? mZ2[s][0] : 0;
+		y[s] = 0;
+	}
+
+	// filling: section s has a frame from step s on
+	int t = 0;
+	for ( ; t < n - 1; ++t)
+	{
+		x[0] = inSourceP[t];
+		for (int s = 1; s < kWidth; ++s) x[s] = y[s - 1];
+		StepSections<kWidth, Ramp>(x, y, z1, z2, ramp, t, 0, t);
+	}
+
+	// every section busy; frame t - (n - 1) leaves the last one
+	VecCoefficients vk = VecSplat(ramp.from), vstep = VecSplat(ramp.step);
+	Vec4 vz1[Vectors], vz2[Vectors], vy[Vectors], vnext[Vectors];
+	for (int v = 0; v < Vectors; ++v)
+	{
+		vz1[v] = VecLoad(z1 + 4*v);
+		vz2[v] = VecLoad(z2 + 4*v);
+		vy[v] = VecLoad(y + 4*v);
+
+		// i + 1 of the frame each section is on
+		float next = (float)(t + 1 - 4*v);
+		vnext[v] = VecSet(next, next - 1, next - 2, next - 3);
+	}
+	Vec4 one = VecSplat(1);
+	int last = n - 1;
+	for ( ; t < frames; ++t)
+	{
+		VecCoefficients k[Vectors];
+		for (int v = 0; v < Vectors; ++v)
+		{
+			if (!Ramp) k[v] = vk;
+			else
+			{
+				k[v] = VecRampAt(vk, vstep, vnext[v]);
+				vnext[v] = VecAdd(vnext[v], one);
+			}
+		}
+
+		// from the top down, so each vector shifts in what the one below gave last step
+		for (int v = Vectors - 1; v > 0; --v) vy[v] = VecSection(k[v], VecShiftIn(vy[v], vy[v - 1]), vz1[v], vz2[v]);
+		vy[0] = VecSection(k[0], VecShiftIn(vy[0], VecSplat(inSourceP[t])), vz1[0], vz2[0]);
+
+		VecStore(y + (last & ~3), vy[last >> 2]);
+		inDestP[t - last] = y[last];
+	}
+	for (int v = 0; v < Vectors; ++v)
+	{
+		VecStore(z1 + 4*v, vz1[v]);
+		VecStore(z2 + 4*v, vz2[v]);
+		VecStore(y + 4*v, vy[v]);
+	}
+
+	// draining: section s has no frame left after step frames - 1 + s
+	for ( ; t < frames + n - 1; ++t)
+	{
+		x[0] = 0;
+		for (int s = 1; s < kWidth; ++s) x[s] = y[s - 1];
+		StepSections<kWidth, Ramp>(x, y, z1, z2, ramp, t, t - frames + 1, kWidth - 1);
+		inDestP[t - last] = y[last];
+	}
+
+	for (int s = 0; s < n; ++s)
+	{
+		mZ1[s][0] = ScrubDenormal(z1[s]);
+		mZ2[s][0] = ScrubDenormal(z2[s]);
+	}
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	BiquadCascade::Process()
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void		BiquadCascade::Process( const float *inSourceP, float *inDestP, int inFramesToProcess )
+{
+	if (inFramesToProcess <= 0) return;
+
+	if (mSections == 0)
+	{
+		if (inDestP != inSourceP) memmove(inDestP, inSourceP, inFramesToProcess * sizeof(float));
+	}
+	else if (mSections == 1 || inFramesToProcess < mSections)
+	{
+		if (mRamping) ProcessSerial<true>(inSourceP, inDestP, inFramesToProcess);
+		else ProcessSerial<false>(inSourceP, inDestP, inFramesToProcess);
+	}
+	else if (mSections <= 4)
+	{
+		if (mRamping) ProcessSteps<1, true>(inSourceP, inDestP, inFramesToProcess);
+		else ProcessSteps<1, false>(inSourceP, inDestP, inFramesToProcess);
+	}
+	else
+	{
+		if (mRamping) ProcessSteps<2, true>(inSourceP, inDestP, inFramesToProcess);
+		else ProcessSteps<2, false>(inSourceP, inDestP, inFramesToProcess);
+	}
+	mRamping = false;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	BiquadCascade::ProcessLanes()
+//
+//		4 * Vectors channels side by side, the ones past inChannels reading the first
+//		channel's samples and going nowhere. The sections step as in ProcessSteps,
+//		section s on frame t - s, so that none of them waits on another within a
+//		step; taking them from the last down lets each read what the one before it
+//		gave out in the step before. A ramp gives each section the coefficients of
+//		its frame, the same in every lane; section 0 works them out, and the ones
+//		after it find them in the ring of the last kMaxSections frames' sets.
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+template <int Vectors, bool Ramp>
+void		BiquadCascade::ProcessLanes(	const float *const	*inSources,
+											float *const		*inDests,
+											int					inChannels,
+											int					inFramesToProcess )
+{
+	const int kLanes = 4 * Vectors;
+	const CoefficientRamp ramp = MakeRamp(Ramp ? mRampFrom : mCoefficients, mCoefficients, inFramesToProcess);
+	int n = mSections;
+	int frames = inFramesToProcess;
+
+	const float *sources[kLanes];
+	for (int c = 0; c < kLanes; ++c) sources[c] = inSources[(c < inChannels) ? c : 0];
+
+	VecCoefficients vk = VecSplat(ramp.from), vstep = VecSplat(ramp.step);
+	VecCoefficients ring[kMaxSections];			// frame i's at i % kMaxSections
+	Vec4 z1[kMaxSections][Vectors], z2[kMaxSections][Vectors], y[kMaxSections][Vectors];
+	for (int s = 0; s < n; ++s)
+	{
+		for (int v = 0; v < Vectors; ++v)
+		{
+			z1[s][v] = VecLoad(&mZ1[s][4*v]);
+			z2[s][v] = VecLoad(&mZ2[s][4*v]);
+		}
+	}
+
+	for (int t = 0; t < frames + n - 1; ++t)
+	{
+		int first = (t < frames) ? 0 : t - frames + 1;		// the sections with a frame in this step
+		int last = (t < n - 1) ? t : n - 1;
+
+		for (int s = last; s >= first && s > 0; --s)
+		{
+			const VecCoefficients &k = Ramp ? ring[(t - s) % kMaxSections] : vk;
+			for (int v = 0; v < Vectors; ++v) y[s][v] = VecSection(k, y[s - 1][v], z1[s][v], z2[s][v]);
+		}
+
+		if (first == 0)
+		{
+			if (Ramp) ring[t % kMaxSections] = VecRampAt(vk, vstep, VecSplat((float)(t + 1)));
+			const VecCoefficients &k = Ramp ? ring[t % kMaxSections] : vk;
+			for (int v = 0; v < Vectors; ++v)
+			{
+				const float *const *lane = sources + 4*v;
+				Vec4 x = VecSet(lane[0][t], lane[1][t], lane[2][t], lane[3][t]);
+				y[0][v] = VecSection(k, x, z1[0][v], z2[0][v]);
+			}
+		}
+
+		if (t >= n - 1)
+		{
+			float frame[kLanes];
+			for (int v = 0; v < Vectors; ++v) VecStore(frame + 4*v, y[n - 1][v]);
+			for (int c = 0; c < inChannels; ++c) inDests[c][t - (n - 1)] = frame[c];
+		}
+	}
+
+	for (int s = 0; s < n; ++s)
+	{
+		for (int v = 0; v < Vectors; ++v)
+		{
+			VecStore(&mZ1[s][4*v], z1[s][v]);
+			VecStore(&mZ2[s][4*v], z2[s][v]);
+		}
+		for (int c = 0; c < kLanes; ++c)
+		{
+			mZ1[s][c] = ScrubDenormal(mZ1[s][c]);
+			mZ2[s][c] = ScrubDenormal(mZ2[s][c]);
+		}
+	}
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	BiquadCascade::ProcessChannels()
+//
+//		Channel c keeps its state in lane c, so a cascade should always be handed
+//		the same channels
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void		BiquadCascade::ProcessChannels(	const float *const	*inSources,
+											float *const		*inDests,
+											int					inChannels,
+											int					inFramesToProcess )
+{
+	if (inChannels > kMaxLanes) inChannels = kMaxLanes;
+
+	if (inChannels <= 0 || inFramesToProcess <= 0) return;
+	else if (mSections == 0)
+	{
+		for (int c = 0; c < inChannels; ++c)
+		{
+			if (inDests[c] != inSources[c]) memmove(inDests[c], inSources[c], inFramesToProcess * sizeof(float));
+		}
+	}
+	else if (inChannels == 1) Process(inSources[0], inDests[0], inFramesToProcess);
+	else if (inChannels <= 4)
+	{
+		if (mRamping) ProcessLanes<1, true>(inSources, inDests, inChannels, inFramesToProcess);
+		else ProcessLanes<1, false>(inSources, inDests, inChannels, inFramesToProcess);
+	}
+	else
+	{
+		if (mRamping) ProcessLanes<2, true>(inSources, inDests, inChannels, inFramesToProcess);
+		else ProcessLanes<2, false>(inSources, inDests, inChannels, inFramesToProcess);
+	}
+	mRamping = false;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	BiquadCascade::ProcessReference()
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void		BiquadCascade::ProcessReference( const float *inSourceP, float *inDestP, int inFramesToProcess )
+{
+	if (inFramesToProcess <= 0) return;
+
+	if (mRamping) ProcessSerial<true>(inSourceP, inDestP, inFramesToProcess);
+	else ProcessSerial<false>(inSourceP, inDestP, inFramesToProcess);
+	mRamping = false;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#pragma mark ____LopassTable
+
+// What CalculateLopassParams needs from the math library: the sin and cos of pi times the
+//  cutoff, and the gain of the resonance. Each is looked up at the nearest point below in a
+//  table and carried the rest of the way with a few terms of a Taylor series, which agrees
+//  with the library to about 1e-12. The cutoff's points are kStepsPerOctave to an octave,
+//  found from its exponent and mantissa, so the step shrinks with the frequency; below
+//  kOctaves the series alone is as close. Outside the ranges the parameters can have, the
+//  library is called after all.
+class LopassTable
+{
+public:
+	static const LopassTable &	Shared();
+
+	// of pi * inFreq, with inFreq normalized 0 -> 1
+	void				SinCos( double inFreq, double &outSin, double &outCos ) const;
+
+	// 10 ^ (-inDecibels / 20)
+	double				Gain( double inDecibels ) const;
+
+private:
+	LopassTable();
+
+	static const int	kOctaves = 16;
+	static const int	kStepsPerOctave = 32;		// a power of two, so the points are exact
+	static const int	kGainSteps = 64;
+
+	double				mSin[kOctaves][kStepsPerOctave];
+	double				mCos[kOctaves][kStepsPerOctave];
+	double				mGain[kGainSteps];
+};
+
+// sin and cos of small angles, for inX up to about pi/64
+static inline double SinSeries( double inX ) { double xx = inX*inX; return inX*(1.0 - xx/6.0*(1.0 - xx/20.0)); }
+static inline double CosSeries( double inX ) { double xx = inX*inX; return 1.0 - xx/2.0*(1.0 - xx/12.0*(1.0 - xx/30.0)); }
+
+// the natural log of 10, over 20: 10 ^ (-x / 20) is exp(-kGainPerDecibel * x)
+static const double kGainPerDecibel = 0.11512925464970228;
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	LopassTable::Shared()
+//
+//		Built the first time it's asked for; FilterCore's constructor asks, so that's
+//		never on the render thread
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+const LopassTable &	LopassTable::Shared()
+{
+	static const LopassTable table;
+	return table;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	LopassTable::LopassTable()
+//
+//		Point j of octave o is 2^-o * (0.5 + j / (2 * kStepsPerOctave))
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+LopassTable::LopassTable()
+{
+	for (int o = 0; o < kOctaves; ++o)
+	{
+		for (int j = 0; j < kStepsPerOctave; ++j)
+		{
+			double freq = ldexp(0.5 + 0.5 * j / kStepsPerOctave, -o);
+			mSin[o][j] = sin(M_PI * freq);
+			mCos[o][j] = cos(M_PI * freq);
+		}
+	}
+
+	for (int j = 0; j < kGainSteps; ++j)
+	{
+		double decibels = kMinResonance + (kMaxResonance - kMinResonance) * j / kGainSteps;
+		mGain[j] = exp(-kGainPerDecibel * decibels);
+	}
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	LopassTable::SinCos()
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void		LopassTable::SinCos( double inFreq, double &outSin, double &outCos ) const
+{
+	if (!(inFreq >= 0.0 && inFreq <= 1.0))
+	{
+		outSin = sin(M_PI * inFreq);
+		outCos = cos(M_PI * inFreq);
+		return;
+	}
+
+	if (inFreq < ldexp(0.5, 1 - kOctaves))
+	{
+		outSin = SinSeries(M_PI * inFreq);
+		outCos = CosSeries(M_PI * inFreq);
+		return;
+	}
+
+	// inFreq = mantissa * 2^exponent, with 1 taken as the top of the first octave
+	int exponent = 0;
+	double mantissa = (inFreq < 1.0) ? frexp(inFreq, &exponent) : 1.0;
+	int octave = -exponent;
+	int j = (int)((mantissa - 0.5) * (2 * kStepsPerOctave));
+	if (j > kStepsPerOctave - 1) j = kStepsPerOctave - 1;
+
+	// the angle from point j on, and the angle sum formulas
+	double delta = M_PI * ldexp(mantissa - (0.5 + 0.5 * j / kStepsPerOctave), exponent);
+	double sinDelta = SinSeries(delta), cosDelta = CosSeries(delta);
+	double sinPoint = mSin[octave][j], cosPoint = mCos[octave][j];
+
+	outSin = sinPoint * cosDelta + cosPoint * sinDelta;
+	outCos = cosPoint * cosDelta - sinPoint * sinDelta;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	LopassTable::Gain()
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+double		LopassTable::Gain( double inDecibels ) const
+{
+	if (!(inDecibels >= kMinResonance && inDecibels <= kMaxResonance))
+		return pow(10.0, 0.05 * -inDecibels);
+
+	const double kSpacing = (kMaxResonance - kMinResonance) / kGainSteps;
+	int j = (int)((inDecibels - kMinResonance) / kSpacing);
+	if (j > kGainSteps - 1) j = kGainSteps - 1;
+
+	// exp(-x) = 1 - x + x^2/2 - x^3/6 + x^4/24 for the rest
+	double x = kGainPerDecibel * (inDecibels - (kMinResonance + j * kSpacing));
+	return mGain[j] * (1.0 - x*(1.0 - x/2.0*(1.0 - x/3.0*(1.0 - x/4.0))));
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#pragma mark ____FilterCore
+
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	FilterCore::FilterCore()
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+FilterCore::FilterCore( double inSampleRate )
+	: mSampleRate(inSampleRate), mLine(NULL), mCapacity(0), mLength(1), mNextLength(1),
+	  mUsed(0), mHead(0), mFeedback(kDefaultResonance)
+{
+	LopassTable::Shared();		// built here rather than in the first render
+	Reset();
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	FilterCore::~FilterCore()
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+FilterCore::~FilterCore()
+{
+	free(mLine);
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	FilterCore::CombCapacityFor()
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+long		FilterCore::CombCapacityFor( double inSampleRate )
+{
+	long longest = (long)kMaxCuttofHz * kCombSamplesPerCutoff;
+	long capped = (long)ceil(inSampleRate * kMaxCombSeconds);
+	if (capped < 1) capped = 1;
+	return (capped < longest) ? capped : longest;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	FilterCore::Allocate()
+//
+//		Called from Filter::Initialize, where the sample rate may have changed since
+//		the kernel was built. A line of the same capacity is kept, and only emptied.
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+bool		FilterCore::Allocate( double inSampleRate )
+{
+	mSampleRate = inSampleRate;
+
+	long capacity = CombCapacityFor(inSampleRate);
+	if (mLine == NULL || capacity != mCapacity)
+	{
+		free(mLine);
+		mLine = (float *)calloc(capacity + 1, sizeof(float));
+		mCapacity = (mLine != NULL) ? capacity : 0;
+		mUsed = 0;
+		if (mLine == NULL) return false;
+	}
+
+	mLength = mNextLength = 1;
+	Reset();
+	return true;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	FilterCore::Reset()
+//
+//		It's very important to fully reset all filter state variables to their
+//		initial settings here.  For delay/reverb effects, the delay buffers must
+//		also be cleared here.
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void		FilterCore::Reset()
+{
+	mLopass.Reset();
+
+	// forces filter coefficient calculation
+	mLastCutoff = -1.0;
+	mLastResonance = -1.0;
+
+	// only as much of the comb as the delay has reached since it was last cleared
+	if (mLine != NULL) memset(mLine, 0, (mUsed + 1) * sizeof(float));
+	mHead = 0;
+	mLength = mNextLength;
+	mUsed = mLength;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	FilterCore::SetCombLength()
+//
+//		Takes effect at once unless the head is already past the new length, in which
+//		case it waits for the head to wrap. Either way nothing is cleared or moved.
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void		FilterCore::SetCombLength( long inLength )
+{
+	if (inLength > mCapacity) inLength = mCapacity;
+	if (inLength < 1) inLength = 1;
+
+	mNextLength = inLength;
+	if (mHead < inLength) mLength = inLength;
+	if (inLength > mUsed) mUsed = inLength;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	FilterCore::CalculateLopassParams()
+//
+//		inFreq is normalized frequency 0 -> 1
+//		inResonance is in decibels
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void FilterCore::CalculateLopassParams(	double inFreq,
+										double inResonance )
+{
+	double params[5];
+	LopassParams(inFreq, inResonance, params);
+
+	mA0 = params[0];
+	mA1 = params[1];
+	mA2 = params[2];
+	mB1 = params[3];
+	mB2 = params[4];
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	FilterCore::LopassParams()
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void FilterCore::LopassParams(	double inFreq,
+								double inResonance,
+								double outParams[5] )
+{
+	const LopassTable &table = LopassTable::Shared();
+
+    double r = table.Gain(inResonance);		// convert from decibels to linear
+
+	double sinFreq, cosFreq;
+	table.SinCos(inFreq, sinFreq, cosFreq);
+
+    double k = 0.5 * r * sinFreq;
+    double c1 = 0.5 * (1.0 - k) / (1.0 + k);
+    double c2 = (0.5 + c1) * cosFreq;
+    double c3 = (0.5 + c1 - c2) * 0.25;
+
+    outParams[0] = 2.0 *   c3;
+    outParams[1] = 2.0 *   2.0 * c3;
+    outParams[2] = 2.0 *   c3;
+    outParams[3] = 2.0 *   -c2;
+    outParams[4] = 2.0 *   c1;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	FilterCore::NormalizedCutoff()
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+double FilterCore::NormalizedCutoff( double inCutoff, double inSampleRate )
+{
+	double cutoff = 2.0 * inCutoff / inSampleRate;
+	if(cutoff > 0.99) cutoff = 0.99;		// clip cutoff to highest allowed by sample rate...
+	return cutoff;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	FilterCore::LopassCoefficients()
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+BiquadCoefficients FilterCore::LopassCoefficients() const
+{
+	BiquadCoefficients coefficients = { (float)mA0, (float)mA1, (float)mA2, (float)mB1, (float)mB2 };
+	return coefficients;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	FilterCore::Process(int inFramesToProcess)
+//
+//		We process one non-interleaved stream at a time
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void FilterCore::Process(	const float 	*inSourceP,
+							float 			*inDestP,
+							int 			inFramesToProcess,
+							int				inCutoff,
+							float			inResonance,
+							int				inSections,
+							bool			inSmoothing )
+{
+
+	int cutoff = inCutoff;
+    float resonance = inResonance;
+	int sections = inSections;
+
+	// do bounds checking on parameters
+	//
+    if(cutoff < kMinCutoffHz) cutoff = kMinCutoffHz;
+
+	if(resonance < kMinResonance ) resonance = kMinResonance;
+	if(resonance > kMaxResonance ) resonance = kMaxResonance;
+
+	if(sections < kMinSections) sections = kMinSections;
+	if(sections > kMaxSections) sections = kMaxSections;
+
+	// only calculate the filter coefficients if the parameters have changed from last time
+	if(cutoff != mLastCutoff || resonance != mLastResonance )
+	{
+		// the lowpass takes the cutoff as a 0->1 normalized frequency
+		CalculateLopassParams(NormalizedCutoff(cutoff, mSampleRate), resonance);
+		mLopass.SetCoefficients(LopassCoefficients(), inSmoothing);
+		if (cutoff != mLastCutoff) SetCombLength((long)cutoff * kCombSamplesPerCutoff);
+		mFeedback = resonance;
+		mLastCutoff = cutoff;
+		mLastResonance = resonance;
+	}
+	if(sections != mLopass.Sections()) mLopass.SetSections(sections);
+
+    const float *sourceP = inSourceP;
+    float *destP = inDestP;
+    int n = inFramesToProcess;
+    float mix = 0.6;
+
+	if (mLine == NULL)
+	{
+		// not allocated yet: the comb would only have echoed silence
+		while(n--) *destP++ = mix * *sourceP++;
+		n = 0;
+	}
+
+	// Each sample writes the line at mLength - mHead, then steps the head and reads the
+	// line at the new mHead. The head sweeps the write index down from mLength and the
+	// read index up from 1, so between the head's wraps they cross once, at mLength / 2:
+	// before it every index read is only written later in the sweep, after it every one
+	// was written earlier. Cut there and at the last sample before the wrap, a run can do
+	// all its writes and then all its reads, and still see what the one sample at a time
+	// loop saw. The last sample reads index 0, which is never written, and moves
+	// mLength on, so it goes on its own.
+    while(n > 0) {
+        long crossing = mLength / 2;
+        long end = (mHead < crossing) ? crossing : mLength - 1;
+        long run = end - mHead;
+        if (run > n) run = n;
+
+        if (run > 0) {
+            FeedComb(mLine + (mLength - mHead), sourceP, run, mFeedback);
+            MixComb(destP, mLine + mHead + 1, sourceP, run, mix);
+            mHead += run;
+            sourceP += run;
+            destP += run;
+            n -= run;
+        }
+
+        if (n > 0 && mHead == mLength - 1) {
+            // the feedback decays towards denormals once the input stops
+            float *tap = mLine + 1;
+            *tap = ScrubDenormal(*sourceP + mFeedback * *tap);
+            mHead = 0;
+            mLength = mNextLength;
+            *destP++ = mix*(mLine[0] + *sourceP++);
+            --n;
+        }
+	}
+
+	// the lowpass works on what the comb gives out; with no sections it only lets go of
+	// any ramp, which would be stale by the time sections came back
+	mLopass.Process(inDestP, inDestP, inFramesToProcess);
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#pragma mark ____LopassResponse
+
+// Frequencies LopassResponse works on at once, in the manner of kCombVector
+static const int kResponseVector = 4;
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	LopassResponse::LopassResponse()
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+LopassResponse::LopassResponse()
+	: mSampleRate(0), mValid(false), mCutoff(0), mResonance(0), mSections(0)
+{
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	LopassResponse::Evaluate()
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void		LopassResponse::Evaluate(	const double	*inFrequencies,
+										double			*outMagnitudes,
+										int				inStride,
+										int				inCount,
+										double			inSampleRate,
+										int				inCutoff,
+										double			inResonance,
+										int				inSections )
+{
+	if (inCount <= 0) return;
+
+	if (inSampleRate != mSampleRate || !SameFrequencies(inFrequencies, inStride, inCount))
+	{
+		mSampleRate = inSampleRate;
+		SetFrequencies(inFrequencies, inStride, inCount);
+		mValid = false;
+	}
+
+	if (!mValid || inCutoff != mCutoff || inResonance != mResonance || inSections != mSections)
+	{
+		mCutoff = inCutoff;
+		mResonance = inResonance;
+		mSections = inSections;
+		CalculateMagnitudes();
+		mValid = true;
+	}
+
+	for (int i = 0; i < inCount; ++i) outMagnitudes[i * inStride] = mMagnitudes[i];
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	LopassResponse::SameFrequencies()
+//
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+bool		LopassResponse::SameFrequencies( const double *inFrequencies, int inStride, int inCount ) const
+{
+	if ((int)mFrequencies.size() != inCount) return false;
+
+	for (int i = 0; i < inCount; ++i)
+	{
+		if (inFrequencies[i * inStride] != mFrequencies[i]) return false;
+	}
+	return true;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	LopassResponse::SetFrequencies()
+//
+//		The only sin and cos the response calls, once a frequency; the block past the
+//		last frequency is padded with 0 Hz
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void		LopassResponse::SetFrequencies( const double *inFrequencies, int inStride, int inCount )
+{
+	int padded = (inCount + kResponseVector - 1) / kResponseVector * kResponseVector;
+
+	mFrequencies.resize(inCount);
+	mCos.assign(padded, 1.0);
+	mSin.assign(padded, 0.0);
+	mCos2.assign(padded, 1.0);
+	mSin2.assign(padded, 0.0);
+	mMagnitudes.resize(padded);
+
+	for (int i = 0; i < inCount; ++i)
+	{
+		mFrequencies[i] = inFrequencies[i * inStride];
+
+		// frequency on unit circle in z-plane
+		double w = M_PI * 2.0 * mFrequencies[i] / mSampleRate;
+		mCos[i] = cos(w);
+		mSin[i] = sin(w);
+		mCos2[i] = mCos[i]*mCos[i] - mSin[i]*mSin[i];
+		mSin2[i] = 2.0*mCos[i]*mSin[i];
+	}
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	LopassResponse::CalculateMagnitudes()
+//
+//		One section's squared magnitude is the zeros' over the poles', with z on the unit
+//		circle; mSections of them are that to the power mSections / 2, a multiply a pair
+//		and one sqrt for an odd one out
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void		LopassResponse::CalculateMagnitudes()
+{
+	double params[5];
+	FilterCore::LopassParams(FilterCore::NormalizedCutoff(mCutoff, mSampleRate), mResonance, params);
+	double a0 = params[0], a1 = params[1], a2 = params[2];
+	double b1 = params[3], b2 = params[4];
+
+	int sections = (mSections > 0) ? mSections : 0;
+	int padded = (int)mMagnitudes.size();
+
+	for (int j = 0; j < padded; j += kResponseVector)
+	{
+		const double *c = &mCos[j], *s = &mSin[j], *c2 = &mCos2[j], *s2 = &mSin2[j];
+
+		double squared[kResponseVector], magnitude[kResponseVector];
+		for (int k = 0; k < kResponseVector; ++k)
+		{
+			// zeros response
+			double num_r = a0*c2[k] + a1*c[k] + a2;
+			double num_i = a0*s2[k] + a1*s[k];
+
+			// poles response
+			double den_r = c2[k] + b1*c[k] + b2;
+			double den_i = s2[k] + b1*s[k];
+
+			squared[k] = (num_r*num_r + num_i*num_i) / (den_r*den_r + den_i*den_i);
+			magnitude[k] = 1.0;
+		}
+
+		for (int p = 0; p < sections / 2; ++p)
+		{
+			for (int k = 0; k < kResponseVector; ++k) magnitude[k] *= squared[k];
+		}
+		if (sections & 1)
+		{
+			for (int k = 0; k < kResponseVector; ++k) magnitude[k] *= sqrt(squared[k]);
+		}
+
+		for (int k = 0; k < kResponseVector; ++k) mMagnitudes[j + k] = magnitude[k];
+	}
+}
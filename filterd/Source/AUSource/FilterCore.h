@@ -0,0 +1,246 @@
+/*
+Copyright (C) 2016 Apple Inc. All Rights Reserved.
+See LICENSE.txt for this sample’s licensing information
+
+Abstract:
+Filter Effect DSP, shared by the AU and the offline tools
+*/
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "Denormals.h"
+
+#ifndef __FilterCore_h__
+#define __FilterCore_h__
+
+// Nothing in this file depends on the AU SDK or Core Foundation. FilterKernel wraps it
+//  in an AUKernelBase, and tools/ builds it on its own to render files without a host.
+
+// cutoff ~ delay time (samples)
+const int kMinCutoffHz = 16;
+const int kMaxCuttofHz = 512*512;
+const int kDefaultCutoff = 512;
+
+// the comb delays cutoff * kCombSamplesPerCutoff samples, up to kMaxCombSeconds
+const int kCombSamplesPerCutoff = 512;
+const double kMaxCombSeconds = 6.0;
+
+// resonance ~ feedback (float)
+const float kMinResonance = 0.0;
+const float kMaxResonance = 1.0;
+const float kDefaultResonance = 0;
+
+// lowpass sections run on the comb's output; 0 leaves it out
+const int kMinSections = 0;
+const int kMaxSections = 8;
+const int kDefaultSections = 0;
+
+// lowpass smoothing, on or off: the coefficients move a frame at a time across the buffer
+// after cutoff or resonance changes, rather than jumping at its start
+const int kDefaultSmoothing = 1;
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#pragma mark ____BiquadCascade
+
+struct BiquadCoefficients		// named as FilterCore's: a for the zeros, b for the poles
+{
+	float	a0, a1, a2;
+	float	b1, b2;
+};
+
+// Up to kMaxSections identical biquads in series, in transposed direct form II:
+//
+//		y = a0*x + z1		z1 = a1*x + z2 - b1*y		z2 = a2*x - b2*y
+//
+// The state is kept for kMaxLanes channels side by side. Process runs one channel and
+// works on the sections in parallel instead: while section 0 takes frame i, section s
+// takes frame i - s, so each step is one vector operation across the sections, filling
+// at the start of the buffer and draining at the end. ProcessChannels puts 4 channels to
+// a vector and steps the sections the same way. Both do the same arithmetic as running
+// the sections one at a time, in the same order.
+//
+// New coefficients either take effect at the start of the next buffer, or are ramped to:
+// frame i of an n frame buffer then runs with the old ones plus (i + 1)/n of the way to the
+// new, so the last frame has them. Every set in between is a stable filter when the ends
+// are, as the region of stable b1, b2 is convex.
+//
+// The state is flushed of denormals at the end of each buffer.
+class BiquadCascade
+{
+public:
+	static const int	kMaxLanes = 8;
+
+	BiquadCascade();
+
+	void				Reset();
+
+	// sections beyond inSections are emptied, so they start from silence when added back
+	void				SetSections( int inSections );
+	int					Sections() const { return mSections; }
+
+	// With inRamp, the next buffer moves to inCoefficients from where the last one left
+	// off, unless that was before Reset. Setting them again first only moves the target.
+	void				SetCoefficients( const BiquadCoefficients &inCoefficients, bool inRamp );
+
+	// one channel, in lane 0; inSourceP may be inDestP
+	void				Process( const float *inSourceP, float *inDestP, int inFramesToProcess );
+
+	// inChannels (up to kMaxLanes) non-interleaved channels; a source may be its dest
+	void				ProcessChannels(	const float *const	*inSources,
+											float *const		*inDests,
+											int					inChannels,
+											int					inFramesToProcess );
+
+	// as Process, but a section at a time and without vectors: what Process and
+	// ProcessChannels must give bit for bit, which tools/filter-golden checks
+	void				ProcessReference( const float *inSourceP, float *inDestP, int inFramesToProcess );
+
+private:
+	template <bool Ramp>
+	void				ProcessSerial( const float *inSourceP, float *inDestP, int inFramesToProcess );
+
+	template <int Vectors, bool Ramp>
+	void				ProcessSteps( const float *inSourceP, float *inDestP, int inFramesToProcess );
+
+	template <int Vectors, bool Ramp>
+	void				ProcessLanes(	const float *const	*inSources,
+										float *const		*inDests,
+										int					inChannels,
+										int					inFramesToProcess );
+
+	int					mSections;
+	BiquadCoefficients	mCoefficients;
+	BiquadCoefficients	mRampFrom;			// where the next buffer starts, when mRamping
+	bool				mRamping;
+	bool				mStarted;			// coefficients have been set since Reset
+	float				mZ1[kMaxSections][kMaxLanes];
+	float				mZ2[kMaxSections][kMaxLanes];
+};
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#pragma mark ____FilterCore
+
+class FilterCore		// the state and DSP of one channel
+{
+public:
+	FilterCore( double inSampleRate );
+	~FilterCore();
+
+	// frames the comb holds at inSampleRate: the longest delay the parameters can ask
+	// for, capped at kMaxCombSeconds
+	static long			CombCapacityFor( double inSampleRate );
+
+	// sizes the comb for inSampleRate and empties it; false when out of memory. Until
+	// the first call, Process leaves out the comb.
+	bool				Allocate( double inSampleRate );
+
+	// processes one channel of non-interleaved samples with the parameter values in
+	// effect for this buffer, which are bounds checked here; inSections lowpass sections
+	// follow the comb, and with inSmoothing they ramp to new coefficients
+	void				Process(	const float 	*inSourceP,
+									float		 	*inDestP,
+									int 			inFramesToProcess,
+									int				inCutoff,
+									float			inResonance,
+									int				inSections,
+									bool			inSmoothing );
+
+	// resets the filter state
+	void				Reset();
+
+	// works from tables rather than the math library over the parameters' ranges, so it
+	// costs no pow, sin or cos on the render thread
+	void				CalculateLopassParams(	double inFreq, double inResonance );
+
+	// what CalculateLopassParams works out, without keeping it: a0, a1, a2 for the
+	// zeros, then b1, b2 for the poles
+	static void			LopassParams( double inFreq, double inResonance, double outParams[5] );
+
+	// the cutoff parameter as CalculateLopassParams takes it, 0 -> 1
+	static double		NormalizedCutoff( double inCutoff, double inSampleRate );
+
+	// the coefficients CalculateLopassParams last worked out, for a BiquadCascade
+	BiquadCoefficients	LopassCoefficients() const;
+
+
+private:
+	double	mSampleRate;
+
+	// filter coefficients
+	double	mA0;
+	double	mA1;
+	double	mA2;
+	double	mB1;
+	double	mB2;
+
+	double	mLastCutoff;
+	double	mLastResonance;
+
+	BiquadCascade	mLopass;
+
+	// The comb's line, from calloc so pages the delay never reaches stay untouched. It
+	// holds mCapacity + 1 samples: writes go to mLength - mHead, 1 to mLength.
+	float	*mLine;
+	long	mCapacity;
+	long	mLength;
+	long	mNextLength;		// a shorter length than mHead waits for the head to wrap
+	long	mUsed;				// the longest length since the line was last cleared
+	long	mHead;
+	float	mFeedback;
+
+	void				SetCombLength( long inLength );
+
+	FilterCore( const FilterCore & );
+	FilterCore &operator=( const FilterCore & );
+};
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#pragma mark ____LopassResponse
+
+// The magnitude response of the lowpass at the frequencies a view asks for, as the
+// Filter's frequency response property reports it. The unit circle terms of the
+// frequencies are kept until the frequencies or the sample rate change, and the
+// magnitudes until the parameters change too, so a view polling a filter that hasn't
+// changed only costs a compare of what it asked for. One thread at a time.
+class LopassResponse
+{
+public:
+	LopassResponse();
+
+	// inCount magnitudes, for the frequencies in Hz from inFrequencies and into
+	// outMagnitudes, each inStride doubles after the last: the response of inSections
+	// of the lowpass at the cutoff and resonance parameters given
+	void				Evaluate(	const double	*inFrequencies,
+									double			*outMagnitudes,
+									int				inStride,
+									int				inCount,
+									double			inSampleRate,
+									int				inCutoff,
+									double			inResonance,
+									int				inSections );
+
+private:
+	bool				SameFrequencies( const double *inFrequencies, int inStride, int inCount ) const;
+	void				SetFrequencies( const double *inFrequencies, int inStride, int inCount );
+	void				CalculateMagnitudes();
+
+	double				mSampleRate;
+	std::vector<double>	mFrequencies;		// as last asked for
+
+	// of each frequency's angle w on the unit circle, padded to whole blocks
+	std::vector<double>	mCos;
+	std::vector<double>	mSin;
+	std::vector<double>	mCos2;				// of 2w
+	std::vector<double>	mSin2;
+
+	bool				mValid;				// mMagnitudes go with these parameters
+	int					mCutoff;
+	double				mResonance;
+	int					mSections;
+	std::vector<double>	mMagnitudes;
+};
+
+#endif
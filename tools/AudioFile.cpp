@@ -0,0 +1,396 @@
+/*
+Abstract:
+Streaming audio file reading and writing for the offline tools
+*/
+
+// This file defines the AudioFileReader and AudioFileWriter classes. They do their own byte
+//  order handling, so they work the same on big and little endian hosts.
+
+#include "AudioFile.h"
+#include <math.h>
+#include <string.h>
+
+static uint32_t BigEndian32 (const uint8_t *p) {return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | p[3];}
+static uint16_t BigEndian16 (const uint8_t *p) {return (uint16_t) ((p[0] << 8) | p[1]);}
+static uint32_t LittleEndian32 (const uint8_t *p) {return ((uint32_t) p[3] << 24) | ((uint32_t) p[2] << 16) | ((uint32_t) p[1] << 8) | p[0];}
+static uint16_t LittleEndian16 (const uint8_t *p) {return (uint16_t) ((p[1] << 8) | p[0]);}
+
+// the 80 bit IEEE extended float AIFF stores its sample rate in
+static double Extended80 (const uint8_t *p) {
+	int exponent = ((p[0] & 0x7F) << 8) | p[1];
+	uint64_t mantissa = 0;
+	for (int i = 0; i < 8; ++i) mantissa = (mantissa << 8) | p[2 + i];
+	if (exponent == 0 && mantissa == 0) return 0;
+	double value = ldexp ((double) mantissa, exponent - 16383 - 63);
+	return (p[0] & 0x80) ? -value : value;
+}
+
+#pragma mark ____IMA4
+
+// IMA ADPCM step sizes and the step index change for each 4 bit code
+static const int kIMAStepTable[89] = {
+	7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+	50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+	337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+	2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+	15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+static const int kIMAIndexTable[16] = {-1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8};
+
+// Apple's IMA4 packs each channel into 34 byte packets of 64 samples: a 16 bit header
+//  holding the top 9 bits of the predictor and a 7 bit step index, then 32 bytes of codes,
+//  low nibble first. Each packet starts from its own header, so none depends on another.
+static const int kIMA4FramesPerPacket = 64;
+static const int kIMA4BytesPerPacket = 34;
+
+static void DecodeIMA4Packet (const uint8_t *inPacket, float *outSamples, int inStride) {
+	uint16_t header = BigEndian16 (inPacket);
+	int predictor = (int16_t) (header & 0xFF80);
+	int index = header & 0x7F;
+	if (index > 88) index = 88;
+
+	for (int i = 0; i < kIMA4FramesPerPacket; ++i) {
+		uint8_t byte = inPacket[2 + i/2];
+		int code = (i & 1) ? (byte >> 4) : (byte & 0x0F);
+
+		int step = kIMAStepTable[index];
+		int difference = step >> 3;
+		if (code & 1) difference += step >> 2;
+		if (code & 2) difference += step >> 1;
+		if (code & 4) difference += step;
+		if (code & 8) difference = -difference;
+
+		predictor += difference;
+		if (predictor > 32767) predictor = 32767;
+		if (predictor < -32768) predictor = -32768;
+		index += kIMAIndexTable[code];
+		if (index < 0) index = 0;
+		if (index > 88) index = 88;
+
+		outSamples[i * inStride] = predictor / 32768.0f;
+	}
+}
+
+#pragma mark ____AudioFileReader
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	AudioFileReader::Open
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+bool AudioFileReader::Open (const char *inPath) {
+	Close ();
+	mError.clear ();
+
+	mFile = fopen (inPath, "rb");
+	if (mFile == NULL) return Fail ("can't open the file");
+
+	uint8_t header[12];
+	if (fread (header, 1, 12, mFile) != 12) return Fail ("file is too short");
+
+	bool parsed;
+	if (memcmp (header, "FORM", 4) == 0 && memcmp (header + 8, "AIFF", 4) == 0) parsed = ParseAIFF (false);
+	else if (memcmp (header, "FORM", 4) == 0 && memcmp (header + 8, "AIFC", 4) == 0) parsed = ParseAIFF (true);
+	else if (memcmp (header, "RIFF", 4) == 0 && memcmp (header + 8, "WAVE", 4) == 0) parsed = ParseWAV ();
+	else return Fail ("not an AIFF, AIFC or WAV file");
+
+	if (!parsed) return false;
+	if (mChannels < 1 || mSampleRate <= 0) return Fail ("bad channel count or sample rate");
+	return Rewind ();
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	AudioFileReader::ParseAIFF
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Walks the chunks after the FORM header for COMM and SSND.
+bool AudioFileReader::ParseAIFF (bool inCompressed) {
+	bool haveFormat = false, haveData = false;
+	uint32_t sampleFrames = 0;
+	int sampleSize = 0;
+
+	uint8_t chunk[8];
+	while (fread (chunk, 1, 8, mFile) == 8) {
+		uint32_t size = BigEndian32 (chunk + 4);
+		long start = ftell (mFile);
+
+		if (memcmp (chunk, "COMM", 4) == 0) {
+			uint8_t comm[22];
+			size_t want = inCompressed ? 22 : 18;
+			if (size < want || fread (comm, 1, want, mFile) != want) return Fail ("short COMM chunk");
+			mChannels = BigEndian16 (comm);
+			sampleFrames = BigEndian32 (comm + 2);
+			sampleSize = BigEndian16 (comm + 6);
+			mSampleRate = Extended80 (comm + 8);
+
+			mEncoding = kEncoding_Integer;
+			mBigEndian = true;
+			mUnsigned8 = false;
+			if (inCompressed) {
+				const uint8_t *type = comm + 18;
+				if (memcmp (type, "NONE", 4) == 0 || memcmp (type, "twos", 4) == 0) {
+				} else if (memcmp (type, "sowt", 4) == 0) {
+					mBigEndian = false;
+				} else if (memcmp (type, "fl32", 4) == 0 || memcmp (type, "FL32", 4) == 0) {
+					mEncoding = kEncoding_Float;
+					sampleSize = 32;
+				} else if (memcmp (type, "fl64", 4) == 0 || memcmp (type, "FL64", 4) == 0) {
+					mEncoding = kEncoding_Float;
+					sampleSize = 64;
+				} else if (memcmp (type, "ima4", 4) == 0) {
+					mEncoding = kEncoding_IMA4;
+				} else {
+					return Fail ("unsupported AIFC compression type");
+				}
+			}
+			haveFormat = true;
+		} else if (memcmp (chunk, "SSND", 4) == 0) {
+			uint8_t ssnd[8];
+			if (size < 8 || fread (ssnd, 1, 8, mFile) != 8) return Fail ("short SSND chunk");
+			mDataOffset = start + 8 + BigEndian32 (ssnd);
+			haveData = true;
+		}
+
+		if (fseek (mFile, start + size + (size & 1), SEEK_SET) != 0) break;
+	}
+
+	if (!haveFormat || !haveData) return Fail ("missing COMM or SSND chunk");
+
+	if (mEncoding == kEncoding_IMA4) {
+		// the frame count of an IMA4 file counts packets
+		mFrames = (int64_t) sampleFrames * kIMA4FramesPerPacket;
+		mBytesPerSample = 0;
+	} else {
+		if (sampleSize < 1 || sampleSize > 64) return Fail ("bad sample size");
+		mFrames = sampleFrames;
+		mBytesPerSample = (sampleSize + 7) / 8;
+		if (mEncoding == kEncoding_Integer && mBytesPerSample > 4) return Fail ("bad sample size");
+	}
+	return true;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	AudioFileReader::ParseWAV
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Walks the chunks after the RIFF header for fmt and data.
+bool AudioFileReader::ParseWAV () {
+	bool haveFormat = false, haveData = false;
+	uint32_t dataBytes = 0;
+
+	uint8_t chunk[8];
+	while (fread (chunk, 1, 8, mFile) == 8) {
+		uint32_t size = LittleEndian32 (chunk + 4);
+		long start = ftell (mFile);
+
+		if (memcmp (chunk, "fmt ", 4) == 0) {
+			uint8_t fmt[26];
+			size_t want = (size >= 26) ? 26 : 16;
+			if (size < 16 || fread (fmt, 1, want, mFile) != want) return Fail ("short fmt chunk");
+			int format = LittleEndian16 (fmt);
+			if (format == 0xFFFE && want == 26) format = LittleEndian16 (fmt + 24);	// WAVE_FORMAT_EXTENSIBLE
+			mChannels = LittleEndian16 (fmt + 2);
+			mSampleRate = LittleEndian32 (fmt + 4);
+			int bits = LittleEndian16 (fmt + 14);
+
+			mBigEndian = false;
+			mBytesPerSample = (bits + 7) / 8;
+			if (format == 1 && mBytesPerSample >= 1 && mBytesPerSample <= 4) {
+				mEncoding = kEncoding_Integer;
+				mUnsigned8 = (mBytesPerSample == 1);
+			} else if (format == 3 && (bits == 32 || bits == 64)) {
+				mEncoding = kEncoding_Float;
+			} else {
+				return Fail ("unsupported WAV sample format");
+			}
+			haveFormat = true;
+		} else if (memcmp (chunk, "data", 4) == 0) {
+			mDataOffset = start;
+			dataBytes = size;
+			haveData = true;
+		}
+
+		if (fseek (mFile, start + size + (size & 1), SEEK_SET) != 0) break;
+	}
+
+	if (!haveFormat || !haveData) return Fail ("missing fmt or data chunk");
+	mFrames = dataBytes / (mBytesPerSample * mChannels);
+	return true;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	AudioFileReader::Rewind
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+bool AudioFileReader::Rewind () {
+	if (mFile == NULL) return false;
+	if (fseek (mFile, mDataOffset, SEEK_SET) != 0) return Fail ("can't seek to the audio data");
+	mFramesRead = 0;
+	mPacketFrame = kIMA4FramesPerPacket;
+	return true;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	AudioFileReader::Read
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+long AudioFileReader::Read (float *outSamples, long inFrames) {
+	if (mFile == NULL) return 0;
+	if (inFrames > mFrames - mFramesRead) inFrames = (long) (mFrames - mFramesRead);
+	if (inFrames <= 0) return 0;
+
+	long frames = 0;
+	if (mEncoding == kEncoding_IMA4) {
+		while (frames < inFrames) {
+			if (mPacketFrame == kIMA4FramesPerPacket && !DecodePacket ()) break;
+			long count = kIMA4FramesPerPacket - mPacketFrame;
+			if (count > inFrames - frames) count = inFrames - frames;
+			memcpy (outSamples + frames * mChannels, &mPacket[mPacketFrame * mChannels], sizeof (float) * count * mChannels);
+			mPacketFrame += (int) count;
+			frames += count;
+		}
+	} else {
+		size_t samples = (size_t) inFrames * mChannels;
+		mRaw.resize (samples * mBytesPerSample);
+		size_t got = fread (&mRaw[0], mBytesPerSample * mChannels, inFrames, mFile);
+		samples = got * mChannels;
+
+		const uint8_t *p = &mRaw[0];
+		for (size_t i = 0; i < samples; ++i, p += mBytesPerSample) {
+			uint8_t b[8];
+			for (int k = 0; k < mBytesPerSample; ++k) b[k] = mBigEndian ? p[k] : p[mBytesPerSample - 1 - k];
+			// b now holds the sample most significant byte first
+			if (mEncoding == kEncoding_Float) {
+				if (mBytesPerSample == 4) {
+					uint32_t bits = BigEndian32 (b);
+					float value;
+					memcpy (&value, &bits, 4);
+					outSamples[i] = value;
+				} else {
+					uint64_t bits = ((uint64_t) BigEndian32 (b) << 32) | BigEndian32 (b + 4);
+					double value;
+					memcpy (&value, &bits, 8);
+					outSamples[i] = (float) value;
+				}
+			} else {
+				uint32_t bits = 0;
+				for (int k = 0; k < mBytesPerSample; ++k) bits |= (uint32_t) b[k] << (24 - 8*k);
+				if (mUnsigned8) bits ^= 0x80000000u;
+				outSamples[i] = (float) ((int32_t) bits / 2147483648.0);
+			}
+		}
+		frames = (long) got;
+	}
+
+	mFramesRead += frames;
+	return frames;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	AudioFileReader::DecodePacket
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Decodes the next packet of every channel, which follow one another in the file.
+bool AudioFileReader::DecodePacket () {
+	size_t bytes = (size_t) kIMA4BytesPerPacket * mChannels;
+	mRaw.resize (bytes);
+	if (fread (&mRaw[0], 1, bytes, mFile) != bytes) return false;
+
+	mPacket.resize ((size_t) kIMA4FramesPerPacket * mChannels);
+	for (int c = 0; c < mChannels; ++c)
+		DecodeIMA4Packet (&mRaw[c * kIMA4BytesPerPacket], &mPacket[c], mChannels);
+	mPacketFrame = 0;
+	return true;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	AudioFileReader::Fail
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+bool AudioFileReader::Fail (const char *inMessage) {
+	mError = inMessage;
+	Close ();
+	return false;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	AudioFileReader::Close
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void AudioFileReader::Close () {
+	if (mFile != NULL) fclose (mFile);
+	mFile = NULL;
+}
+
+#pragma mark ____AudioFileWriter
+
+static void PutLittleEndian32 (uint8_t *p, uint32_t inValue) {
+	p[0] = (uint8_t) inValue; p[1] = (uint8_t) (inValue >> 8); p[2] = (uint8_t) (inValue >> 16); p[3] = (uint8_t) (inValue >> 24);
+}
+static void PutLittleEndian16 (uint8_t *p, uint16_t inValue) {
+	p[0] = (uint8_t) inValue; p[1] = (uint8_t) (inValue >> 8);
+}
+
+// RIFF header, a WAVE_FORMAT_IEEE_FLOAT fmt chunk and the data chunk header
+static const int kWAVHeaderBytes = 44;
+
+static void FillWAVHeader (uint8_t *outHeader, int inChannels, double inSampleRate, int64_t inFrames) {
+	uint32_t dataBytes = (uint32_t) (inFrames * inChannels * 4);
+	memcpy (outHeader, "RIFF", 4);
+	PutLittleEndian32 (outHeader + 4, 36 + dataBytes);
+	memcpy (outHeader + 8, "WAVEfmt ", 8);
+	PutLittleEndian32 (outHeader + 16, 16);
+	PutLittleEndian16 (outHeader + 20, 3);
+	PutLittleEndian16 (outHeader + 22, (uint16_t) inChannels);
+	PutLittleEndian32 (outHeader + 24, (uint32_t) inSampleRate);
+	PutLittleEndian32 (outHeader + 28, (uint32_t) inSampleRate * inChannels * 4);
+	PutLittleEndian16 (outHeader + 32, (uint16_t) (inChannels * 4));
+	PutLittleEndian16 (outHeader + 34, 32);
+	memcpy (outHeader + 36, "data", 4);
+	PutLittleEndian32 (outHeader + 40, dataBytes);
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	AudioFileWriter::Open
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+bool AudioFileWriter::Open (const char *inPath, int inChannels, double inSampleRate) {
+	Close ();
+	mFile = fopen (inPath, "wb");
+	if (mFile == NULL) return false;
+	mChannels = inChannels;
+	mSampleRate = inSampleRate;
+	mFramesWritten = 0;
+
+	// written again with the real sizes by Close
+	uint8_t header[kWAVHeaderBytes];
+	FillWAVHeader (header, inChannels, inSampleRate, 0);
+	return fwrite (header, 1, kWAVHeaderBytes, mFile) == kWAVHeaderBytes;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	AudioFileWriter::Write
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+bool AudioFileWriter::Write (const float *inSamples, long inFrames) {
+	if (mFile == NULL) return false;
+
+	uint8_t buffer[4096];
+	size_t samples = (size_t) inFrames * mChannels, done = 0;
+	while (done < samples) {
+		size_t count = samples - done;
+		if (count > sizeof (buffer) / 4) count = sizeof (buffer) / 4;
+		for (size_t i = 0; i < count; ++i) {
+			uint32_t bits;
+			memcpy (&bits, &inSamples[done + i], 4);
+			PutLittleEndian32 (buffer + 4*i, bits);
+		}
+		if (fwrite (buffer, 4, count, mFile) != count) return false;
+		done += count;
+	}
+	mFramesWritten += inFrames;
+	return true;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	AudioFileWriter::Close
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+bool AudioFileWriter::Close () {
+	if (mFile == NULL) return true;
+
+	uint8_t header[kWAVHeaderBytes];
+	FillWAVHeader (header, mChannels, mSampleRate, mFramesWritten);
+	bool ok = fseek (mFile, 0, SEEK_SET) == 0 && fwrite (header, 1, kWAVHeaderBytes, mFile) == kWAVHeaderBytes;
+	ok = (fclose (mFile) == 0) && ok;
+	mFile = NULL;
+	return ok;
+}
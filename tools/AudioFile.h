@@ -0,0 +1,93 @@
+/*
+Abstract:
+Streaming audio file reading and writing for the offline tools
+*/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#ifndef __AudioFile_h__
+#define __AudioFile_h__
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// AudioFileReader
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Reads AIFF, AIFC and WAV files a block at a time as interleaved floats, so a file never
+//  has to fit in memory. Understands integer PCM of 8 to 32 bits in either byte order,
+//  32 and 64 bit float, and Apple's IMA 4:1 ADPCM ('ima4'), which the test tones in
+//  tremd/test_tones use.
+#pragma mark ____AudioFileReader
+class AudioFileReader {
+	public:
+		AudioFileReader () {}
+		~AudioFileReader () {Close ();}
+
+		// false if the file can't be opened or isn't in a format listed above; Error()
+		//  says why
+		bool Open (const char *inPath);
+		void Close ();
+
+		// reads up to inFrames frames into outSamples, Channels() floats a frame; returns
+		//  the frames read, which is short only at the end of the file
+		long Read (float *outSamples, long inFrames);
+
+		// goes back to the first frame
+		bool Rewind ();
+
+		int			Channels () const {return mChannels;}
+		double		SampleRate () const {return mSampleRate;}
+		int64_t		Frames () const {return mFrames;}
+		const char	*Error () const {return mError.c_str ();}
+
+	private:
+		enum Encoding {kEncoding_Integer, kEncoding_Float, kEncoding_IMA4};
+
+		bool ParseAIFF (bool inCompressed);
+		bool ParseWAV ();
+		bool Fail (const char *inMessage);
+		bool DecodePacket ();
+
+		FILE		*mFile = NULL;
+		std::string	mError;
+
+		int			mChannels = 0;
+		double		mSampleRate = 0;
+		int64_t		mFrames = 0;
+		int64_t		mFramesRead = 0;
+		long		mDataOffset = 0;		// byte offset of the first frame
+
+		Encoding	mEncoding = kEncoding_Integer;
+		int			mBytesPerSample = 0;
+		bool		mBigEndian = true;
+		bool		mUnsigned8 = false;		// WAV stores 8 bit samples offset by 128
+
+		std::vector<uint8_t>	mRaw;		// one block of file data
+		std::vector<float>		mPacket;	// one decoded IMA4 packet, interleaved
+		int						mPacketFrame = 0;	// next frame of mPacket to hand out
+};
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// AudioFileWriter
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Writes interleaved floats to a 32 bit float WAV file as they are rendered; Close()
+//  fills in the sizes.
+#pragma mark ____AudioFileWriter
+class AudioFileWriter {
+	public:
+		AudioFileWriter () {}
+		~AudioFileWriter () {Close ();}
+
+		bool Open (const char *inPath, int inChannels, double inSampleRate);
+		bool Write (const float *inSamples, long inFrames);
+		bool Close ();
+
+	private:
+		FILE		*mFile = NULL;
+		int			mChannels = 0;
+		double		mSampleRate = 0;
+		int64_t		mFramesWritten = 0;
+};
+
+#endif
@@ -0,0 +1,146 @@
+/*
+Abstract:
+Regression checks for the Filter's lowpass cascade
+*/
+
+// This file defines the filter-golden command. It runs noise through BiquadCascade's vector
+//  paths, Process for one channel and ProcessChannels for up to kMaxLanes, and compares
+//  them sample by sample against ProcessReference, which runs each channel's sections one
+//  at a time. Every case changes the coefficients every few blocks, most often with the
+//  ramp on, and cuts the input into blocks of random, mostly odd, sizes, down to 1 frame
+//  and below the number of sections. The Makefile builds FilterCore for this command with
+//  SCRUB_DENORMALS=0, so nothing but the arithmetic can tell the paths apart.
+//
+//	filter-golden [-f frames] [-s seed]
+//
+//		-f <frames>		frames each case runs, 20000 by default
+//		-s <seed>		seeds the noise, the block sizes and the coefficients, 1 by default
+//
+// The paths do the same arithmetic in the same order, so they must match bit for bit. Each
+//  case prints its maximum absolute error and the first frame where it isn't 0; the exit
+//  status is 1 if any case has one.
+
+#include "FilterCore.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+// a deterministic random number generator, the same on every platform
+struct Random {
+	uint32_t state;
+
+	Random (uint32_t inSeed) : state (inSeed) {}
+
+	uint32_t Next () {state = state*1664525 + 1013904223; return state >> 8;}
+	float Uniform () {return Next () * (1.0f / 16777216.0f);}				// [0, 1)
+	int Integer (int inMinimum, int inMaximum) {return inMinimum + (int) (Next () % (inMaximum - inMinimum + 1));}
+};
+
+struct Comparison {
+	double	maxError = 0;
+	long	firstDivergence = -1;	// frame, or -1
+};
+
+// The lowpass at a random cutoff and resonance over the parameters' ranges at 44.1 kHz,
+//  as FilterCore works it out
+static BiquadCoefficients RandomCoefficients (Random &ioRandom) {
+	double cutoff = kMinCutoffHz * pow ((double) kMaxCuttofHz / kMinCutoffHz, ioRandom.Uniform ());
+	double resonance = kMinResonance + ioRandom.Uniform () * (kMaxResonance - kMinResonance);
+	double params[5];
+	FilterCore::LopassParams (FilterCore::NormalizedCutoff (cutoff, 44100), resonance, params);
+	BiquadCoefficients coefficients = {(float) params[0], (float) params[1], (float) params[2], (float) params[3], (float) params[4]};
+	return coefficients;
+}
+
+// Runs inFrames of noise on inChannels channels through inSections sections, on one cascade
+//  with the vector paths and on one a channel with ProcessReference. Half the blocks are 1
+//  to 7 frames and the rest an odd size up to 699; every fourth block on average sets new
+//  coefficients, three times in four ramped to. Odd numbered blocks run in place.
+static Comparison Run (int inSections, int inChannels, long inFrames, uint32_t inSeed) {
+	Random random (inSeed);
+	std::vector<std::vector<float> > input (inChannels), actual (inChannels), expected (inChannels);
+	for (int c = 0; c < inChannels; ++c) {
+		input[c].resize (inFrames);
+		for (long i = 0; i < inFrames; ++i) input[c][i] = 2 * random.Uniform () - 1;
+		actual[c].resize (inFrames);
+		expected[c].resize (inFrames);
+	}
+
+	BiquadCascade cascade;
+	std::vector<BiquadCascade> references (inChannels);
+	cascade.SetSections (inSections);
+	for (int c = 0; c < inChannels; ++c) references[c].SetSections (inSections);
+
+	int blocks = 0;
+	for (long start = 0; start < inFrames; ++blocks) {
+		int block = (random.Next () & 1) ? random.Integer (1, 7) : random.Integer (1, 350) * 2 - 1;
+		if (block > inFrames - start) block = (int) (inFrames - start);
+
+		if (blocks == 0 || random.Next () % 4 == 0) {
+			BiquadCoefficients coefficients = RandomCoefficients (random);
+			bool ramp = random.Next () % 4 != 0;
+			cascade.SetCoefficients (coefficients, ramp);
+			for (int c = 0; c < inChannels; ++c) references[c].SetCoefficients (coefficients, ramp);
+		}
+
+		const float *sources[BiquadCascade::kMaxLanes];
+		float *dests[BiquadCascade::kMaxLanes];
+		bool inPlace = (blocks & 1) != 0;
+		for (int c = 0; c < inChannels; ++c) {
+			dests[c] = &actual[c][start];
+			if (inPlace) memcpy (dests[c], &input[c][start], block * sizeof (float));
+			sources[c] = inPlace ? dests[c] : &input[c][start];
+			references[c].ProcessReference (&input[c][start], &expected[c][start], block);
+		}
+		if (inChannels == 1) cascade.Process (sources[0], dests[0], block);
+		else cascade.ProcessChannels (sources, dests, inChannels, block);
+		start += block;
+	}
+
+	Comparison result;
+	for (int c = 0; c < inChannels; ++c) {
+		for (long i = 0; i < inFrames; ++i) {
+			float a = actual[c][i], e = expected[c][i];
+			if (a == e) continue;
+			double error = fabs ((double) a - e);
+			if (!(error <= result.maxError)) result.maxError = isnan (error) ? INFINITY : error;
+			if (result.firstDivergence < 0 || i < result.firstDivergence) result.firstDivergence = i;
+		}
+	}
+	return result;
+}
+
+static void Usage () {
+	fprintf (stderr, "usage: filter-golden [-f frames] [-s seed]\n");
+	exit (2);
+}
+
+int main (int argc, char *argv[]) {
+	long frames = 20000;
+	uint32_t seed = 1;
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp (argv[i], "-f") == 0 && i + 1 < argc) frames = atol (argv[++i]);
+		else if (strcmp (argv[i], "-s") == 0 && i + 1 < argc) seed = (uint32_t) strtoul (argv[++i], NULL, 0);
+		else Usage ();
+	}
+	if (frames < 1) Usage ();
+
+	bool failed = false;
+	for (int sections = 1; sections <= kMaxSections; ++sections) {
+		for (int channels = 1; channels <= BiquadCascade::kMaxLanes; ++channels) {
+			Comparison comparison = Run (sections, channels, frames, seed + 1000*sections + channels);
+			bool passed = comparison.firstDivergence < 0;
+			failed = failed || !passed;
+			char divergence[32] = "-";
+			if (!passed) snprintf (divergence, sizeof (divergence), "%ld", comparison.firstDivergence);
+			printf ("lowpass %d sections %d ch %8ld frames  max %.3g  first divergence %s  %s\n",
+					sections, channels, frames, comparison.maxError, divergence, passed ? "ok" : "FAILED");
+		}
+	}
+	printf ("%s against ProcessReference, bit exact\n", failed ? "FAILED" : "passed");
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,232 @@
+/*
+Abstract:
+The tremolo and filter DSP wrapped for the offline tools
+*/
+
+// This file defines the OfflineTremolo and OfflineFilter classes, which stand in for
+//  TremoloUnit and the Filter AU when the offline tools run the DSP.
+
+#include "OfflineEffects.h"
+
+#pragma mark ____OfflineTremolo
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	OfflineTremolo::SetParameter
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Like a parameter change between render cycles of the AU, the cores pick up new delay
+//  lengths the next time their heads wrap.
+bool OfflineTremolo::SetParameter (int inID, float inValue) {
+	if (inID < 0 || inID >= kNumberOfParameters) return false;
+	mParameters.Apply (inID, inValue, 0, 0);
+	if (!mCores.empty ()) UpdateDerivedParameters ();
+	return true;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	OfflineTremolo::RampParameter
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+bool OfflineTremolo::RampParameter (int inID, float inValue, float inStep, int inFrames) {
+	if (inID < 0 || inID >= kNumberOfParameters || inFrames < 0) return false;
+	mParameters.Apply (inID, inValue, inStep, (uint32_t) inFrames);
+	if (!mCores.empty ()) UpdateDerivedParameters ();
+	return true;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	OfflineTremolo::Prepare
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// The same linking rule and arena layout as TremoloUnit::Initialize.
+bool OfflineTremolo::Prepare (int inChannels, double inSampleRate, double inBeatsPerMinute, int) {
+	mCores.clear ();
+	mChannels = inChannels;
+	mSampleRate = inSampleRate;
+	mBeatsPerSecond = inBeatsPerMinute/60;
+
+	int linked = (mLinked && inChannels >= 2 && inChannels <= kMaxLinkedLanes) ? inChannels : 0;
+	int lanes = TremoloCore::LanesFor (linked);
+	size_t cores = (linked != 0) ? 1 : (size_t) inChannels;
+
+	long capacity = TremoloDelayArena::CapacityFor (mSampleRate, mDecimation);
+	if (!mDelayArena.Allocate (capacity, cores, lanes, mDecimation)) return false;
+
+	for (size_t i = 0; i < cores; ++i) {
+		mCores.push_back (std::unique_ptr<TremoloCore> (new TremoloCore (&mParameters)));
+		mCores[i]->SetDelayStorage (mDelayArena.LineSet (i, lanes), mDelayArena.stride, capacity, lanes, mDecimation);
+	}
+	mLinkedChannels = linked;
+
+	UpdateDerivedParameters ();
+	return true;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	OfflineTremolo::UpdateDerivedParameters
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void OfflineTremolo::UpdateDerivedParameters () {
+	mParameters.UpdateDelayLengths (mSampleRate, mBeatsPerSecond, mDelayArena.capacity, mDelayArena.decimation);
+	mParameters.UpdateDuck ();
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	OfflineTremolo::Reset
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void OfflineTremolo::Reset () {
+	for (size_t i = 0; i < mCores.size (); ++i) mCores[i]->Reset ();
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	OfflineTremolo::Process
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Linked channels go through the first core in one pass, as in
+//  TremoloUnit::ProcessBufferLists; otherwise each channel gets its own core, as each gets
+//  its own TremoloUnitKernel.
+void OfflineTremolo::Process (const float *inSource, float *outDest, int inFrames) {
+	const float *sources[kMaxLinkedLanes];
+	float *dests[kMaxLinkedLanes];
+	if (mLinkedChannels != 0) {
+		for (int c = 0; c < mLinkedChannels; ++c) {
+			sources[c] = inSource + c;
+			dests[c] = outDest + c;
+		}
+		RenderCore (*mCores[0], sources, dests, mLinkedChannels, inFrames);
+		return;
+	}
+	for (int c = 0; c < mChannels; ++c) {
+		sources[0] = inSource + c;
+		dests[0] = outDest + c;
+		RenderCore (*mCores[c], sources, dests, 1, inFrames);
+	}
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	OfflineTremolo::RenderCore
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void OfflineTremolo::RenderCore (
+	TremoloCore			&ioCore,
+	const float *const	*inSources,
+	float *const		*inDests,
+	int					inChannels,
+	int					inFrames
+) {
+	if (mSkipsSilence && ioCore.IsSilent (inSources, inChannels, mChannels, inFrames)) {
+		ioCore.SkipFrames (inFrames);
+		for (int c = 0; c < inChannels; ++c) {
+			for (int i = 0; i < inFrames; ++i) inDests[c][i*mChannels] = 0;
+		}
+		return;
+	}
+	ioCore.ProcessChannels (inSources, inDests, inChannels, mChannels, inFrames);
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	OfflineTremolo::SaveState
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void OfflineTremolo::SaveState (std::vector<unsigned char> &outState) const {
+	std::vector<uint32_t> sizes (mCores.size ());
+	size_t total = sizeof (uint32_t);
+	for (size_t i = 0; i < mCores.size (); ++i) {
+		sizes[i] = (uint32_t) mCores[i]->StateSize ();
+		total += sizeof (uint32_t) + sizes[i];
+	}
+	outState.resize (total);
+	unsigned char *out = &outState[0];
+	uint32_t count = (uint32_t) mCores.size ();
+	memcpy (out, &count, sizeof (count));
+	out += sizeof (count);
+	for (size_t i = 0; i < mCores.size (); ++i) {
+		memcpy (out, &sizes[i], sizeof (sizes[i]));
+		out += sizeof (sizes[i]);
+		out += mCores[i]->SaveState (out, sizes[i]);
+	}
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	OfflineTremolo::RestoreState
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Every core checks its snapshot before any of them takes one up.
+bool OfflineTremolo::RestoreState (const std::vector<unsigned char> &inState) {
+	uint32_t count;
+	if (inState.size () < sizeof (count)) return false;
+	memcpy (&count, &inState[0], sizeof (count));
+	if (count != mCores.size ()) return false;
+
+	std::vector<std::pair<size_t, uint32_t> > snapshots;	// offset and size
+	size_t offset = sizeof (count);
+	for (size_t i = 0; i < mCores.size (); ++i) {
+		uint32_t size;
+		if (inState.size () - offset < sizeof (size)) return false;
+		memcpy (&size, &inState[offset], sizeof (size));
+		offset += sizeof (size);
+		if (inState.size () - offset < size || !mCores[i]->AcceptsState (&inState[offset], size)) return false;
+		snapshots.push_back (std::make_pair (offset, size));
+		offset += size;
+	}
+	if (offset != inState.size ()) return false;
+
+	for (size_t i = 0; i < mCores.size (); ++i) mCores[i]->RestoreState (&inState[snapshots[i].first], snapshots[i].second);
+	return true;
+}
+
+#pragma mark ____OfflineFilter
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	OfflineFilter::SetParameter
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+bool OfflineFilter::SetParameter (int inID, float inValue) {
+	if (inID == 0) mCutoff = (int) inValue;
+	else if (inID == 1) mResonance = inValue;
+	else if (inID == 2) mSections = (int) inValue;
+	else if (inID == 3) mSmoothing = inValue != 0;
+	else return false;
+	return true;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	OfflineFilter::Prepare
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+bool OfflineFilter::Prepare (int inChannels, double inSampleRate, double, int inMaxFrames) {
+	mChannels = inChannels;
+	mCores.clear ();
+	for (int c = 0; c < inChannels; ++c) {
+		mCores.push_back (std::unique_ptr<FilterCore> (new FilterCore (inSampleRate)));
+		if (!mCores.back ()->Allocate (inSampleRate)) return false;
+	}
+	mLinkedChannels = (mLinked && inChannels >= 2 && inChannels <= BiquadCascade::kMaxLanes) ? inChannels : 0;
+	mLinkedLopass.Reset ();
+	mMaxFrames = inMaxFrames;
+	mSource.resize (inMaxFrames);
+	mDest.resize ((size_t) inMaxFrames * inChannels);
+	return true;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	OfflineFilter::Reset
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void OfflineFilter::Reset () {
+	for (size_t i = 0; i < mCores.size (); ++i) mCores[i]->Reset ();
+	mLinkedLopass.Reset ();
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	OfflineFilter::Process
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// FilterCore works on non-interleaved samples, so each channel is split out of the block
+//  and put back around it.
+void OfflineFilter::Process (const float *inSource, float *outDest, int inFrames) {
+	float *dests[BiquadCascade::kMaxLanes];
+	for (int c = 0; c < mChannels; ++c) {
+		float *dest = &mDest[(size_t) c * mMaxFrames];
+		for (int i = 0; i < inFrames; ++i) mSource[i] = inSource[i*mChannels + c];
+		mCores[c]->Process (&mSource[0], dest, inFrames, mCutoff, mResonance, (mLinkedChannels > 0) ? 0 : mSections, mSmoothing);
+		if (c < BiquadCascade::kMaxLanes) dests[c] = dest;
+	}
+	if (mLinkedChannels > 0) {
+		mLinkedLopass.SetSections (mSections);
+		mLinkedLopass.SetCoefficients (mCores[0]->LopassCoefficients (), mSmoothing);
+		mLinkedLopass.ProcessChannels (dests, dests, mLinkedChannels, inFrames);
+	}
+	for (int c = 0; c < mChannels; ++c) {
+		const float *dest = &mDest[(size_t) c * mMaxFrames];
+		for (int i = 0; i < inFrames; ++i) outDest[i*mChannels + c] = dest[i];
+	}
+}
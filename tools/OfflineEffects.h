@@ -0,0 +1,143 @@
+/*
+Abstract:
+The tremolo and filter DSP wrapped for the offline tools
+*/
+
+#include "TremoloCore.h"
+#include "FilterCore.h"
+
+#include <memory>
+#include <vector>
+
+#ifndef __OfflineEffects_h__
+#define __OfflineEffects_h__
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// OfflineEffect
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// What the tools need from an effect: set up for a stream, then process blocks of
+//  interleaved frames in place of a host's render calls.
+#pragma mark ____OfflineEffect
+class OfflineEffect {
+	public:
+		virtual ~OfflineEffect () {}
+
+		// false if the parameter isn't one of the effect's; may be called between blocks
+		virtual bool SetParameter (int inID, float inValue) = 0;
+
+		// false when out of memory
+		virtual bool Prepare (int inChannels, double inSampleRate, double inBeatsPerMinute, int inMaxFrames) = 0;
+		virtual void Reset () = 0;
+
+		virtual void Process (const float *inSource, float *outDest, int inFrames) = 0;
+};
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// OfflineTremolo
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Does what TremoloUnit does around its kernels: one parameter block shared by every core,
+//  delay lines from a TremoloDelayArena, and linked channels rendered by a single core.
+#pragma mark ____OfflineTremolo
+class OfflineTremolo : public OfflineEffect {
+	public:
+		OfflineTremolo (bool inLinked) : mLinked (inLinked) {}
+		virtual ~OfflineTremolo () {mDelayArena.Free ();}
+
+		virtual bool SetParameter (int inID, float inValue);
+		virtual bool Prepare (int inChannels, double inSampleRate, double inBeatsPerMinute, int inMaxFrames);
+		virtual void Reset ();
+		virtual void Process (const float *inSource, float *outDest, int inFrames);
+
+		// sets a continuous parameter to ramp by inStep a frame over the next inFrames
+		//  frames, as a ramped parameter event does in TremoloUnit; the next SetParameter
+		//  or RampParameter of the same ID ends the ramp
+		bool RampParameter (int inID, float inValue, float inStep, int inFrames);
+
+		const TremoloParameters &Parameters () const {return mParameters;}
+
+		// Skips the cores, as TremoloUnit does, for blocks where TremoloCore::IsSilent
+		//  says the input and the tail are both silent; their output is zeroed. Off by
+		//  default, so every block goes through the render loop.
+		void SetSkipsSilence (bool inSkips) {mSkipsSilence = inSkips;}
+
+		// Stores the delay lines decimated by inDecimation (1, 2 or 4) from the next
+		//  Prepare on, as TremoloUnit does when built with TREMOLO_DECIMATED_LINES.
+		void SetDecimation (int inDecimation) {mDecimation = inDecimation;}
+		int Decimation () const {return mDecimation;}
+
+		// frames each delay line holds, once prepared
+		long Capacity () const {return mDelayArena.capacity;}
+
+		// channels side by side in each delay line index
+		int Lanes () const {return TremoloCore::LanesFor (mLinkedChannels);}
+
+		// The state of every core, framed the way TremoloUnit frames its kernels' in
+		//  kTremoloUnitProperty_KernelState: a count, then each core's size and
+		//  TremoloCore snapshot. RestoreState takes up a snapshot of an instance prepared
+		//  the same way, and is false, leaving the cores as they were, for anything else.
+		void SaveState (std::vector<unsigned char> &outState) const;
+		bool RestoreState (const std::vector<unsigned char> &inState);
+
+		// TremoloCore::AddLineCounts over every core
+		void AddLineCounts (uint64_t &ioResets, uint64_t &ioChunkClears) const {
+			for (size_t i = 0; i < mCores.size (); ++i) mCores[i]->AddLineCounts (ioResets, ioChunkClears);
+		}
+
+	private:
+		void UpdateDerivedParameters ();
+
+		// one ProcessChannels call, or a skip when the block is silent
+		void RenderCore (
+			TremoloCore			&ioCore,
+			const float *const	*inSources,
+			float *const		*inDests,
+			int					inChannels,
+			int					inFrames
+		);
+
+		bool		mLinked;
+		bool		mSkipsSilence = false;
+		int			mDecimation = 1;
+		int			mChannels = 0;
+		int			mLinkedChannels = 0;
+		double		mSampleRate = 0;
+		double		mBeatsPerSecond = 2;
+
+		TremoloParameters	mParameters;
+		TremoloDelayArena	mDelayArena;
+		std::vector<std::unique_ptr<TremoloCore> >	mCores;
+};
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// OfflineFilter
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// One FilterCore a channel, like FilterKernel. Its parameters are 0 (cutoff),
+//  1 (resonance), 2 (lowpass sections) and 3 (lowpass smoothing). Linked, 2 to BiquadCascade::kMaxLanes channels
+//  run the lowpass together after their combs, as the Filter AU does.
+#pragma mark ____OfflineFilter
+class OfflineFilter : public OfflineEffect {
+	public:
+		OfflineFilter (bool inLinked) : mLinked (inLinked) {}
+
+		virtual bool SetParameter (int inID, float inValue);
+		virtual bool Prepare (int inChannels, double inSampleRate, double inBeatsPerMinute, int inMaxFrames);
+		virtual void Reset ();
+		virtual void Process (const float *inSource, float *outDest, int inFrames);
+
+	private:
+		bool	mLinked;
+		int		mChannels = 0;
+		int		mLinkedChannels = 0;
+		int		mCutoff = kDefaultCutoff;
+		float	mResonance = kDefaultResonance;
+		int		mSections = kDefaultSections;
+		bool	mSmoothing = kDefaultSmoothing != 0;
+
+		std::vector<std::unique_ptr<FilterCore> >	mCores;
+		BiquadCascade		mLinkedLopass;
+		std::vector<float>	mSource;				// one channel of a block
+		std::vector<float>	mDest;					// every channel of a block, one after the other
+		int					mMaxFrames = 0;
+};
+
+#endif
@@ -0,0 +1,215 @@
+/*
+Abstract:
+Renders audio files through the commdelay and filter DSP without an AU host
+*/
+
+// This file defines the offline-render command. It streams a file through TremoloCore or
+//  FilterCore a block at a time, the way a host would call the audio unit, and reports how
+//  much faster than real time the DSP ran. Only the DSP calls are timed; reading, decoding
+//  and writing the files are not. Each block is timed by a RenderMeter, as the audio
+//  units time their renders, and measured against how long the block lasts.
+//
+//	offline-render [options] tremolo|filter <input> [<output.wav>]
+//
+//		-b <frames>		block size, 512 by default
+//		-r <hz>			sample rate the DSP runs at, the file's by default; the samples
+//						are not resampled, only the rate the kernel is told changes
+//		-t <bpm>		host tempo for the tremolo's synced delays, 120 by default
+//		-p <id>=<value>	sets a parameter: the tremolo's IDs are in tremd/TremoloCore.h,
+//						the filter's are 0 (cutoff), 1 (resonance), 2 (lowpass sections)
+//						and 3 (lowpass smoothing, 1 or 0)
+//		-n <passes>		renders the file this many times, only the first is written
+//		-u				renders the tremolo with one core per channel instead of linking
+//						the channels into one core, and the filter's lowpass a channel
+//						at a time instead of all of them at once
+//		-m <factor>		stores the tremolo's delay lines decimated by 1, 2 or 4
+//		-i <state>		starts the tremolo from a state file written by -o, rather than
+//						from empty lines, as though the input followed on from that render
+//		-o <state>		writes the tremolo's state at the end of the first pass
+
+#include "AudioFile.h"
+#include "OfflineEffects.h"
+#include "RenderMeter.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#pragma mark ____main
+
+static void Usage () {
+	fprintf (stderr,
+		"usage: offline-render [-b frames] [-r hz] [-t bpm] [-p id=value]... [-n passes] [-u] [-m factor]\n"
+		"                      [-i state] [-o state] tremolo|filter <input> [<output.wav>]\n");
+	exit (2);
+}
+
+// the argument of the option at argv[ioIndex], moving ioIndex past it
+static const char *OptionArgument (int argc, char *argv[], int &ioIndex) {
+	if (ioIndex + 1 >= argc) Usage ();
+	return argv[++ioIndex];
+}
+
+static bool ReadState (const char *inPath, std::vector<unsigned char> &outState) {
+	FILE *file = fopen (inPath, "rb");
+	if (file == NULL) return false;
+	outState.clear ();
+	unsigned char buffer[65536];
+	size_t count;
+	while ((count = fread (buffer, 1, sizeof (buffer), file)) > 0) outState.insert (outState.end (), buffer, buffer + count);
+	bool ok = !ferror (file);
+	fclose (file);
+	return ok;
+}
+
+static bool WriteState (const char *inPath, const std::vector<unsigned char> &inState) {
+	FILE *file = fopen (inPath, "wb");
+	if (file == NULL) return false;
+	bool ok = fwrite (&inState[0], 1, inState.size (), file) == inState.size ();
+	return (fclose (file) == 0) && ok;
+}
+
+int main (int argc, char *argv[]) {
+	int blockFrames = 512;
+	double sampleRate = 0;
+	double beatsPerMinute = 120;
+	int passes = 1;
+	bool linked = true;
+	int decimation = 1;
+	const char *stateInPath = NULL;
+	const char *stateOutPath = NULL;
+	std::vector<std::pair<int, float> > parameters;
+
+	int i = 1;
+	for (; i < argc && argv[i][0] == '-'; ++i) {
+		const char *option = argv[i];
+		if (strcmp (option, "-b") == 0) blockFrames = atoi (OptionArgument (argc, argv, i));
+		else if (strcmp (option, "-r") == 0) sampleRate = atof (OptionArgument (argc, argv, i));
+		else if (strcmp (option, "-t") == 0) beatsPerMinute = atof (OptionArgument (argc, argv, i));
+		else if (strcmp (option, "-n") == 0) passes = atoi (OptionArgument (argc, argv, i));
+		else if (strcmp (option, "-u") == 0) linked = false;
+		else if (strcmp (option, "-m") == 0) decimation = atoi (OptionArgument (argc, argv, i));
+		else if (strcmp (option, "-i") == 0) stateInPath = OptionArgument (argc, argv, i);
+		else if (strcmp (option, "-o") == 0) stateOutPath = OptionArgument (argc, argv, i);
+		else if (strcmp (option, "-p") == 0) {
+			const char *assignment = OptionArgument (argc, argv, i);
+			const char *equals = strchr (assignment, '=');
+			if (equals == NULL) Usage ();
+			parameters.push_back (std::make_pair (atoi (assignment), (float) atof (equals + 1)));
+		}
+		else Usage ();
+	}
+	if (argc - i < 2 || argc - i > 3 || blockFrames < 1 || passes < 1 || beatsPerMinute <= 0 || sampleRate < 0
+		|| (decimation != 1 && decimation != 2 && decimation != 4)) Usage ();
+
+	const char *effectName = argv[i];
+	const char *inputPath = argv[i + 1];
+	const char *outputPath = (argc - i == 3) ? argv[i + 2] : NULL;
+
+	std::unique_ptr<OfflineEffect> effect;
+	OfflineTremolo *tremolo = NULL;
+	if (strcmp (effectName, "tremolo") == 0) {
+		tremolo = new OfflineTremolo (linked);
+		tremolo->SetDecimation (decimation);
+		effect.reset (tremolo);
+	}
+	else if (strcmp (effectName, "filter") == 0) effect.reset (new OfflineFilter (linked));
+	else Usage ();
+	if (tremolo == NULL && (stateInPath != NULL || stateOutPath != NULL)) Usage ();
+
+	for (size_t p = 0; p < parameters.size (); ++p) {
+		if (!effect->SetParameter (parameters[p].first, parameters[p].second)) {
+			fprintf (stderr, "offline-render: %s has no parameter %d\n", effectName, parameters[p].first);
+			return 1;
+		}
+	}
+
+	AudioFileReader reader;
+	if (!reader.Open (inputPath)) {
+		fprintf (stderr, "offline-render: %s: %s\n", inputPath, reader.Error ());
+		return 1;
+	}
+	int channels = reader.Channels ();
+	if (sampleRate == 0) sampleRate = reader.SampleRate ();
+
+	if (!effect->Prepare (channels, sampleRate, beatsPerMinute, blockFrames)) {
+		fprintf (stderr, "offline-render: out of memory\n");
+		return 1;
+	}
+
+	AudioFileWriter writer;
+	if (outputPath != NULL && !writer.Open (outputPath, channels, sampleRate)) {
+		fprintf (stderr, "offline-render: can't write %s\n", outputPath);
+		return 1;
+	}
+
+	std::vector<unsigned char> state;
+	if (stateInPath != NULL && !ReadState (stateInPath, state)) {
+		fprintf (stderr, "offline-render: can't read %s\n", stateInPath);
+		return 1;
+	}
+
+	std::vector<float> source ((size_t) blockFrames * channels);
+	std::vector<float> dest ((size_t) blockFrames * channels);
+	RenderMeter meter;
+
+	for (int pass = 0; pass < passes; ++pass) {
+		if (pass > 0 && !reader.Rewind ()) {
+			fprintf (stderr, "offline-render: %s: %s\n", inputPath, reader.Error ());
+			return 1;
+		}
+		effect->Reset ();
+		if (stateInPath != NULL && !tremolo->RestoreState (state)) {
+			fprintf (stderr, "offline-render: %s doesn't match this channel count, rate, tempo or build\n", stateInPath);
+			return 1;
+		}
+
+		long frames;
+		while ((frames = reader.Read (&source[0], blockFrames)) > 0) {
+			uint64_t start = RenderMeter::Now ();
+			effect->Process (&source[0], &dest[0], (int) frames);
+			meter.AddRender (start, RenderMeter::Now (), (uint32_t) frames, sampleRate);
+
+			if (pass == 0 && outputPath != NULL && !writer.Write (&dest[0], frames)) {
+				fprintf (stderr, "offline-render: can't write %s\n", outputPath);
+				return 1;
+			}
+		}
+		if (pass == 0 && stateOutPath != NULL) {
+			tremolo->SaveState (state);
+			if (!WriteState (stateOutPath, state)) {
+				fprintf (stderr, "offline-render: can't write %s\n", stateOutPath);
+				return 1;
+			}
+		}
+	}
+	if (outputPath != NULL && !writer.Close ()) {
+		fprintf (stderr, "offline-render: can't write %s\n", outputPath);
+		return 1;
+	}
+
+	if (tremolo != NULL) {
+		uint64_t lineResets = 0, lineClears = 0;
+		tremolo->AddLineCounts (lineResets, lineClears);
+		meter.SetLineCounts (lineResets, lineClears);
+	}
+	RenderMeterStats stats;
+	meter.Read (stats);
+
+	double audioSeconds = stats.frames / sampleRate;
+	double renderSeconds = stats.nanos * 1e-9;
+	printf ("%s: %d ch, %.0f Hz, %d frame blocks, %d pass%s\n",
+			effectName, channels, sampleRate, blockFrames, passes, (passes == 1) ? "" : "es");
+	printf ("rendered %.2f s of audio in %.4f s, %.1fx real time (%.1f ns a frame)\n",
+			audioSeconds, renderSeconds, (renderSeconds > 0) ? audioSeconds/renderSeconds : 0.0,
+			(stats.frames > 0) ? 1e9*renderSeconds/stats.frames : 0.0);
+	printf ("slowest block %.1f us, %llu of %llu over their deadline; blocks by tenths of it:",
+			stats.maxNanos * 1e-3, (unsigned long long) stats.overruns, (unsigned long long) stats.renders);
+	for (int b = 0; b < kRenderMeterBins; ++b) printf (" %llu", (unsigned long long) stats.histogram[b]);
+	printf ("\n");
+	if (tremolo != NULL) {
+		printf ("delay lines emptied %llu times, %llu chunks zeroed\n",
+				(unsigned long long) stats.lineResets, (unsigned long long) stats.lineClears);
+	}
+	return 0;
+}
@@ -0,0 +1,341 @@
+/*
+Abstract:
+Microbenchmarks for the commdelay DSP
+*/
+
+// This file defines the tremolo-bench command. It runs TremoloCore the way
+//  TremoloUnitKernel::Process does, over generated noise, and sweeps one setting at a time
+//  away from the defaults: block size, sample rate, the two exponents, the directions and
+//  the length. A last scenario changes the length every block, so each wrap of the main
+//  head has to start an empty line, which is where clearing the lines used to cost a
+//  memset of the whole line on the render thread. The tail scenario stops the input and
+//  prints a row for every two seconds of silence after it; tail_skip does the same with
+//  silent blocks skipped once the lines have died away, as TremoloUnit skips them. The
+//  decimation scenario runs 192 kHz with the lines stored at full rate and decimated by 2
+//  and 4, at a length that fits either way and at the default one, which only fits
+//  decimated.
+//
+// Builds with TREMOLO_LINE_STORAGE set store the lines in 16 bits; the storage column
+//  says which format a run used, and error_dbfs what it cost. Their rows line up with a
+//  float build's, so the two CSVs compare row by row.
+//
+// Every configuration prints one CSV row:
+//
+//	scenario		sweep the row belongs to
+//	block ... decimation	the settings it ran with; direction 1 is forward and 2
+//					backward, for all three heads, signature and speed are the main
+//					line's, and decimation is the frames per stored line sample
+//	storage			the format the lines store samples in, from TREMOLO_LINE_STORAGE
+//	ns_per_sample	wall time of the Process calls per sample per channel
+//	cycles_per_sample	the same in time stamp counter ticks, or -1 where there is no
+//					counter to read
+//	max_block_ns	the slowest single block, which shows spikes the mean hides
+//	bytes_touched	the delay line memory the lengths in use reach, plus the input and
+//					output blocks; compare it with the cache sizes
+//	error_dbfs		rms difference from TremoloReference, which keeps its lines in float
+//					at full rate, in dB relative to full scale; rendered outside the
+//					timed blocks, and -200 where the two agree exactly
+//
+//	tremolo-bench [-s seconds] [-c channels] [-u] [-d] [-q]
+//
+//		-s <seconds>	audio rendered per configuration, 2 by default
+//		-c <channels>	channels rendered, 1 by default (one kernel's work)
+//		-u				renders each channel with its own core instead of linking them
+//		-d				renders without the DenormalGuard the AU renders in; build with
+//						SCRUB_DENORMALS=0 as well to see what the tail costs unprotected
+//		-q				quick run: only the default configuration, the rate change one
+//						and the two tail ones
+
+#include "OfflineEffects.h"
+#include "TremoloReference.h"
+
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined (__x86_64__) || defined (__i386__)
+	#include <x86intrin.h>
+	static inline int64_t ReadCycles () {return (int64_t) __rdtsc ();}
+	static const bool kHaveCycles = true;
+#else
+	static inline int64_t ReadCycles () {return 0;}
+	static const bool kHaveCycles = false;
+#endif
+
+#pragma mark ____BenchConfig
+
+// the settings of one benchmark row
+struct BenchConfig {
+	const char	*scenario = "default";
+	int			block = 512;
+	double		rate = 44100;
+	int			delayPower = kDefaultValue_Delay_Power;
+	int			signalPower = (int) kDefaultValue_Signal_Power;
+	int			direction = kDefaultValue_Direction;
+	int			length = kDefaultValue_Length;
+	int			signature = kDefaultValue_Signature;
+	int			speed = kDefaultValue_Speed;
+	bool		changeRate = false;		// toggles the length every block
+	double		seconds = 0;			// run length, or 0 for the -s option
+	double		inputSeconds = -1;		// silence after this much input, or -1 for none
+	double		windowSeconds = 0;		// prints a row for every window this long, or 0 for one
+	bool		skipsSilence = false;	// skips silent blocks once the tail dies, as the AU does
+	int			decimation = 1;			// frames per stored line sample
+};
+
+struct BenchOptions {
+	double		seconds = 2;
+	int			channels = 1;
+	bool		linked = true;
+	bool		flushDenormals = true;	// renders inside a DenormalGuard, as the AU does
+};
+
+// a fixed noise signal, the same on every run and platform
+static void FillNoise (float *outSamples, size_t inCount) {
+	uint32_t state = 0x1234567;
+	for (size_t i = 0; i < inCount; ++i) {
+		state = state*1664525 + 1013904223;
+		outSamples[i] = ((int32_t) state) * (0.5f / 2147483648.0f);
+	}
+}
+
+static void SetDirections (OfflineTremolo &ioTremolo, int inDirection) {
+	ioTremolo.SetParameter (kParameter_Direction, inDirection);
+	ioTremolo.SetParameter (kParameter_Ring_Direction, inDirection);
+	ioTremolo.SetParameter (kParameter_Signal_Power_Direction, inDirection);
+}
+
+#pragma mark ____RunConfig
+
+// the time spent in one stretch of blocks
+struct BenchWindow {
+	std::chrono::steady_clock::duration	elapsed {0};
+	std::chrono::steady_clock::duration	slowest {0};
+	int64_t								cycles = 0;
+	long								blocks = 0;
+	double								squaredError = 0;	// summed against the reference
+};
+
+static void PrintRow (const char *inScenario, const BenchConfig &inConfig, int inChannels,
+					  const BenchWindow &inWindow, int64_t inBytesTouched) {
+	double samples = (double) inWindow.blocks * inConfig.block * inChannels;
+	double ns = std::chrono::duration<double, std::nano> (inWindow.elapsed).count ();
+	double errorPower = inWindow.squaredError/samples;
+	printf ("%s,%d,%.0f,%d,%d,%d,%d,%d,%d,%d,%d,%s,%.3f,%.3f,%.0f,%lld,%.1f\n",
+			inScenario, inConfig.block, inConfig.rate, inConfig.delayPower, inConfig.signalPower,
+			inConfig.direction, inConfig.length, inConfig.signature, inConfig.speed, inChannels,
+			inConfig.decimation, kLineStorageName, ns/samples,
+			kHaveCycles ? inWindow.cycles/samples : -1.0,
+			std::chrono::duration<double, std::nano> (inWindow.slowest).count (), (long long) inBytesTouched,
+			(errorPower > 1e-20) ? 10*log10 (errorPower) : -200.0);
+	fflush (stdout);
+}
+
+// renders one configuration and prints its rows; false when out of memory
+static bool RunConfig (const BenchConfig &inConfig, const BenchOptions &inOptions) {
+	const int channels = inOptions.channels;
+	OfflineTremolo tremolo (inOptions.linked);
+	tremolo.SetParameter (kParameter_Delay_Power, inConfig.delayPower);
+	tremolo.SetParameter (kParameter_Signal_Power, inConfig.signalPower);
+	tremolo.SetParameter (kParameter_Length, inConfig.length);
+	tremolo.SetParameter (kParameter_Signature, inConfig.signature);
+	tremolo.SetParameter (kParameter_Speed, inConfig.speed);
+	SetDirections (tremolo, inConfig.direction);
+	tremolo.SetSkipsSilence (inConfig.skipsSilence);
+	tremolo.SetDecimation (inConfig.decimation);
+	if (!tremolo.Prepare (channels, inConfig.rate, 120, inConfig.block)) return false;
+
+	std::vector<std::unique_ptr<TremoloReference> > references;
+	for (int c = 0; c < channels; ++c)
+		references.push_back (std::unique_ptr<TremoloReference> (new TremoloReference (&tremolo.Parameters (), tremolo.Capacity ())));
+
+	// a whole number of blocks of noise, reused round robin so the input stays in cache
+	//  no matter how long the run, followed by one block of silence
+	const int blocksOfNoise = 64;
+	const size_t blockSamples = (size_t) inConfig.block * channels;
+	std::vector<float> source ((blocksOfNoise + 1) * blockSamples, 0.0f);
+	std::vector<float> dest (blockSamples);
+	std::vector<float> expected (blockSamples);
+	FillNoise (&source[0], blocksOfNoise * blockSamples);
+	const float *silence = &source[blocksOfNoise * blockSamples];
+
+	double seconds = (inConfig.seconds > 0) ? inConfig.seconds : inOptions.seconds;
+	long totalBlocks = (long) (seconds * inConfig.rate / inConfig.block);
+	if (totalBlocks < 1) totalBlocks = 1;
+	long warmupBlocks = totalBlocks/8 + 1;
+	long inputBlocks = (inConfig.inputSeconds >= 0) ? (long) (inConfig.inputSeconds * inConfig.rate / inConfig.block) : totalBlocks;
+	long windowBlocks = (inConfig.windowSeconds > 0) ? (long) (inConfig.windowSeconds * inConfig.rate / inConfig.block) : totalBlocks;
+	if (windowBlocks < 1) windowBlocks = 1;
+
+	const TremoloParameters &parameters = tremolo.Parameters ();
+	int64_t lineSamples = ((int64_t) parameters.samplesPerDelay + parameters.samplesPerRingDelay
+							+ parameters.samplesPerSignalPowerDelay) / inConfig.decimation;
+	// samples at each line index summed over the cores, counting unused lanes
+	int lanes = tremolo.Lanes ();
+	int64_t lineWidth = (channels + lanes - 1) / lanes * lanes;
+	int64_t bytesTouched = 2 * lineSamples * lineWidth * sizeof (TremoloLineSample) + 2 * (int64_t) blockSamples * sizeof (float);
+
+	BenchWindow window;
+	for (long b = -warmupBlocks; b < totalBlocks; ++b) {
+		if (inConfig.changeRate) {
+			int length = (b & 1) ? inConfig.length + 1 : inConfig.length;
+			tremolo.SetParameter (kParameter_Length, length);
+		}
+		const float *in = (b < inputBlocks) ? &source[(size_t) ((b + warmupBlocks) % blocksOfNoise) * blockSamples] : silence;
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+		int64_t startCycles = ReadCycles ();
+		{
+			DenormalGuard denormalGuard (inOptions.flushDenormals);
+			tremolo.Process (in, &dest[0], inConfig.block);
+		}
+		int64_t blockCycles = ReadCycles () - startCycles;
+		std::chrono::steady_clock::duration blockTime = std::chrono::steady_clock::now () - start;
+
+		for (int c = 0; c < channels; ++c) references[c]->Process (in + c, &expected[c], channels, inConfig.block);
+
+		if (b < 0) continue;
+		for (size_t i = 0; i < blockSamples; ++i) {
+			double error = dest[i] - expected[i];
+			window.squaredError += error*error;
+		}
+		window.elapsed += blockTime;
+		window.cycles += blockCycles;
+		window.blocks += 1;
+		if (blockTime > window.slowest) window.slowest = blockTime;
+
+		if (window.blocks == windowBlocks || b == totalBlocks - 1) {
+			if (inConfig.windowSeconds > 0) {
+				// windowed rows are named for the time they start at, relative to the
+				//  end of the input
+				char scenario[64];
+				double at = (b + 1 - window.blocks - inputBlocks) * inConfig.block / inConfig.rate;
+				snprintf (scenario, sizeof (scenario), "%s%+.0fs", inConfig.scenario, at);
+				PrintRow (scenario, inConfig, channels, window, bytesTouched);
+			} else {
+				PrintRow (inConfig.scenario, inConfig, channels, window, bytesTouched);
+			}
+			window = BenchWindow ();
+		}
+	}
+	return true;
+}
+
+#pragma mark ____main
+
+static void Usage () {
+	fprintf (stderr, "usage: tremolo-bench [-s seconds] [-c channels] [-u] [-d] [-q]\n");
+	exit (2);
+}
+
+int main (int argc, char *argv[]) {
+	BenchOptions options;
+	bool quick = false;
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp (argv[i], "-s") == 0 && i + 1 < argc) options.seconds = atof (argv[++i]);
+		else if (strcmp (argv[i], "-c") == 0 && i + 1 < argc) options.channels = atoi (argv[++i]);
+		else if (strcmp (argv[i], "-u") == 0) options.linked = false;
+		else if (strcmp (argv[i], "-q") == 0) quick = true;
+		else if (strcmp (argv[i], "-d") == 0) options.flushDenormals = false;
+		else Usage ();
+	}
+	if (options.seconds <= 0 || options.channels < 1) Usage ();
+
+	std::vector<BenchConfig> configs;
+	BenchConfig config;
+	configs.push_back (config);
+
+	if (!quick) {
+		config = BenchConfig ();
+		config.scenario = "block";
+		for (int block = 16; block <= 4096; block *= 2) {
+			config.block = block;
+			configs.push_back (config);
+		}
+
+		static const double rates[] = {44100, 48000, 88200, 96000, 176400, 192000};
+		config = BenchConfig ();
+		config.scenario = "rate";
+		for (size_t r = 0; r < sizeof (rates) / sizeof (rates[0]); ++r) {
+			config.rate = rates[r];
+			configs.push_back (config);
+		}
+
+		config = BenchConfig ();
+		config.scenario = "exponents";
+		for (int d = kMinimumValue_Delay_Power; d <= kMaximumValue_Delay_Power; ++d) {
+			for (int s = (int) kMinimumValue_Signal_Power; s <= (int) kMaximumValue_Signal_Power; ++s) {
+				config.delayPower = d;
+				config.signalPower = s;
+				configs.push_back (config);
+			}
+		}
+
+		config = BenchConfig ();
+		config.scenario = "direction";
+		config.direction = kForward_Direction;
+		configs.push_back (config);
+		config.direction = kBackward_Direction;
+		configs.push_back (config);
+
+		config = BenchConfig ();
+		config.scenario = "length";
+		for (int length = kMinimumValue_Length; length <= kMaximumValue_Length; ++length) {
+			config.length = length;
+			configs.push_back (config);
+		}
+
+		config = BenchConfig ();
+		config.scenario = "decimation";
+		config.rate = 192000;
+		static const int lengths[] = {2, kDefaultValue_Length};
+		for (size_t l = 0; l < sizeof (lengths) / sizeof (lengths[0]); ++l) {
+			for (int decimation = 1; decimation <= kMaximumDecimation; decimation *= 2) {
+				config.length = lengths[l];
+				config.decimation = decimation;
+				configs.push_back (config);
+			}
+		}
+	}
+
+	// the shortest main line wraps dozens of times a second, and every wrap picks up the
+	//  length set since the last one
+	config = BenchConfig ();
+	config.scenario = "rate_change";
+	config.length = kMinimumValue_Length;
+	config.signature = kMaximumValue_Signature;
+	config.speed = kMaximumValue_Speed;
+	config.changeRate = true;
+	configs.push_back (config);
+
+	// A second of noise, then silence while the lines decay. Every row should cost about
+	//  the same; a rise after the input stops means the lines have reached denormals. The
+	//  short lines wrap, and so decay, many times a second.
+	config = BenchConfig ();
+	config.scenario = "tail";
+	config.length = kMinimumValue_Length;
+	config.signature = kMaximumValue_Signature;
+	config.speed = kMaximumValue_Speed;
+	config.seconds = 31;
+	config.inputSeconds = 1;
+	config.windowSeconds = 2;
+	configs.push_back (config);
+
+	// the same with the silence skipped once the tail has died away, which it has within
+	//  a few seconds; the rows after that are what a dormant instance costs
+	config.scenario = "tail_skip";
+	config.skipsSilence = true;
+	configs.push_back (config);
+
+	printf ("scenario,block,rate,delay_power,signal_power,direction,length,signature,speed,channels,decimation,storage,"
+			"ns_per_sample,cycles_per_sample,max_block_ns,bytes_touched,error_dbfs\n");
+	for (size_t i = 0; i < configs.size (); ++i) {
+		if (!RunConfig (configs[i], options)) {
+			fprintf (stderr, "tremolo-bench: out of memory\n");
+			return 1;
+		}
+	}
+	return 0;
+}
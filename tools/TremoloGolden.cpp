@@ -0,0 +1,395 @@
+/*
+Abstract:
+Golden output regression checks for the commdelay DSP
+*/
+
+// This file defines the tremolo-golden command. It renders a fixed set of stimuli through
+//  TremoloCore, the engine the AU runs, and compares the output sample by sample against
+//  either TremoloReference (the scalar loop) or golden files recorded by an earlier run.
+//
+//	tremolo-golden [-b frames] [-t tolerance] [-x] [-u] [-s] [-k] [-r dir | -g dir] [<input>...]
+//
+//		-b <frames>		block size for the fixed stimuli, 512 by default; the automation
+//						stimuli pick a new random size every block
+//		-t <tolerance>	largest error allowed, relative to the larger of 1 and the expected
+//						sample; 1e-4 against the reference, 0 against golden files
+//		-x				bit exact, the same as -t 0
+//		-u				renders each channel with its own core instead of linking them
+//		-s				skips the render loop for silent blocks once the tail has died
+//						away, as TremoloUnit does; the bursts stimulus leaves room for it
+//		-k				halfway through each stimulus, snapshots the engine's state,
+//						prepares it again from scratch and restores the snapshot, so the
+//						second half checks that a restored engine carries on unchanged
+//		-r <dir>		records the engine's output of every stimulus into dir as golden files
+//		-g <dir>		compares against the golden files in dir instead of the reference
+//		<input>			audio files added to the stimuli, such as tremd/test_tones
+//
+// Each stimulus prints its maximum absolute error, RMS error and the first frame where the
+//  error is over the tolerance; the exit status is 1 if any stimulus has one.
+
+#include "AudioFile.h"
+#include "OfflineEffects.h"
+#include "TremoloReference.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+#pragma mark ____Stimulus
+
+// a deterministic random number generator, the same on every platform
+struct Random {
+	uint32_t state;
+
+	Random (uint32_t inSeed) : state (inSeed) {}
+
+	uint32_t Next () {state = state*1664525 + 1013904223; return state >> 8;}
+	float Uniform () {return Next () * (1.0f / 16777216.0f);}				// [0, 1)
+	int Integer (int inMinimum, int inMaximum) {return inMinimum + (int) (Next () % (inMaximum - inMinimum + 1));}
+};
+
+struct Stimulus {
+	std::string			name;
+	int					channels = 1;
+	double				sampleRate = 44100;
+	std::vector<float>	samples;			// interleaved
+	std::vector<std::pair<int, float> >	parameters;	// set before rendering
+	uint32_t			automationSeed = 0;	// nonzero for random automation and block sizes
+
+	long Frames () const {return (long) (samples.size () / channels);}
+};
+
+// a unit impulse every inSpacing seconds
+static Stimulus Impulses (double inSampleRate, double inSeconds, double inSpacing) {
+	Stimulus stimulus;
+	stimulus.name = "impulses";
+	stimulus.sampleRate = inSampleRate;
+	stimulus.samples.assign ((size_t) (inSampleRate * inSeconds), 0.0f);
+	for (double t = 0; t < inSeconds; t += inSpacing) stimulus.samples[(size_t) (t * inSampleRate)] = 1;
+	return stimulus;
+}
+
+// inCount bursts of noise inLength seconds long, each followed by inGap seconds of silence
+static Stimulus Bursts (double inSampleRate, int inCount, double inLength, double inGap) {
+	Stimulus stimulus;
+	stimulus.name = "bursts";
+	stimulus.sampleRate = inSampleRate;
+	long burst = (long) (inLength * inSampleRate), period = burst + (long) (inGap * inSampleRate);
+	stimulus.samples.assign ((size_t) (inCount * period), 0.0f);
+	Random random (3);
+	for (int b = 0; b < inCount; ++b) {
+		for (long i = 0; i < burst; ++i) stimulus.samples[b*period + i] = 0.5f * (random.Uniform () - 0.5f);
+	}
+	return stimulus;
+}
+
+// an exponential sine sweep from 20 Hz to 20 kHz at half scale
+static void FillSweep (float *outSamples, int inStride, long inFrames, double inSampleRate) {
+	const double f0 = 20, f1 = 20000;
+	const double seconds = inFrames / inSampleRate, k = log (f1/f0);
+	for (long i = 0; i < inFrames; ++i) {
+		double t = i / inSampleRate;
+		outSamples[i*inStride] = (float) (0.5 * sin (2*M_PI*f0*seconds/k * (exp (t/seconds*k) - 1)));
+	}
+}
+
+static Stimulus Sweep (double inSampleRate, double inSeconds) {
+	Stimulus stimulus;
+	stimulus.name = "sweep";
+	stimulus.sampleRate = inSampleRate;
+	stimulus.samples.resize ((size_t) (inSampleRate * inSeconds));
+	FillSweep (&stimulus.samples[0], 1, stimulus.Frames (), inSampleRate);
+	return stimulus;
+}
+
+// noise on the left, a sweep on the right, and every parameter moving
+static Stimulus Automation (const char *inName, double inSampleRate, double inSeconds, uint32_t inSeed) {
+	Stimulus stimulus;
+	stimulus.name = inName;
+	stimulus.channels = 2;
+	stimulus.sampleRate = inSampleRate;
+	stimulus.automationSeed = inSeed;
+	long frames = (long) (inSampleRate * inSeconds);
+	stimulus.samples.resize ((size_t) frames * 2);
+	Random random (inSeed ^ 0x5EED);
+	for (long i = 0; i < frames; ++i) stimulus.samples[2*i] = 0.5f * (random.Uniform () - 0.5f);
+	FillSweep (&stimulus.samples[1], 2, frames, inSampleRate);
+	return stimulus;
+}
+
+static bool LoadFile (const char *inPath, Stimulus &outStimulus) {
+	AudioFileReader reader;
+	if (!reader.Open (inPath)) {
+		fprintf (stderr, "tremolo-golden: %s: %s\n", inPath, reader.Error ());
+		return false;
+	}
+	const char *slash = strrchr (inPath, '/');
+	outStimulus.name = (slash != NULL) ? slash + 1 : inPath;
+	outStimulus.channels = reader.Channels ();
+	outStimulus.sampleRate = reader.SampleRate ();
+	outStimulus.samples.resize ((size_t) reader.Frames () * reader.Channels ());
+	long frames = reader.Read (&outStimulus.samples[0], (long) reader.Frames ());
+	outStimulus.samples.resize ((size_t) frames * reader.Channels ());
+	return true;
+}
+
+#pragma mark ____Automation
+
+// The range each parameter is drawn from, and whether it can ramp. Parameters that set
+//  the delay lengths change rarely, since every change empties a line.
+struct ParameterRange {
+	float	minimum;
+	float	maximum;
+	bool	continuous;
+	int		oneIn;		// chance of a change each block
+};
+
+static const ParameterRange kRanges[kNumberOfParameters] = {
+	{kMinimumValue_Length, kMaximumValue_Length, false, 64},
+	{kForward_Direction, kBackward_Direction, false, 16},
+	{kMinimumValue_Mix, kMaximumValue_Mix, true, 4},
+	{kMinimumValue_Signature, kMaximumValue_Signature, false, 64},
+	{kMinimumValue_Speed, kMaximumValue_Speed, false, 64},
+	{kMinimumValue_Depth, kMaximumValue_Depth, true, 4},
+	{kMinimumValue_Delay_Power, kMaximumValue_Delay_Power, false, 16},
+	{kMinimumValue_Delay_Power_Scale, kMaximumValue_Delay_Power_Scale, true, 4},
+	{kForward_Ring_Direction, kBackward_Ring_Direction, false, 16},
+	{kMinimumValue_Ring_Mix, kMaximumValue_Ring_Mix, true, 4},
+	{kMinimumValue_Ring, kMaximumValue_Ring, true, 4},
+	{kMinimumValue_Ring_Signature, kMaximumValue_Ring_Signature, false, 64},
+	{kMinimumValue_Ring_Speed, kMaximumValue_Ring_Speed, false, 64},
+	{kMinimumValue_Ring_Depth, kMaximumValue_Ring_Depth, true, 4},
+	{kForward_Signal_Power_Direction, kBackward_Signal_Power_Direction, false, 16},
+	{kMinimumValue_Signal_Power, kMaximumValue_Signal_Power, false, 16},
+	{kMinimumValue_Signal_Power_Scale, kMaximumValue_Signal_Power_Scale, true, 4},
+	{kMinimumValue_Signal_Power_Signature, kMaximumValue_Signal_Power_Signature, false, 64},
+	{kMinimumValue_Signal_Power_Speed, kMaximumValue_Signal_Power_Speed, false, 64},
+	{kMinimumValue_Signal_Power_Depth, kMaximumValue_Signal_Power_Depth, true, 4},
+	{kMinimumValue_Fade, kMaximumValue_Fade, false, 16},
+	{kMinimumValue_Duck, kMaximumValue_Duck, false, 16}
+};
+
+// Moves the parameters for the next block of inFrames frames: some jump, some of the
+//  continuous ones ramp across the block, and the rest hold. ioValues holds each
+//  parameter's value at the start of the block.
+static void Automate (Random &ioRandom, float *ioValues, int inFrames, OfflineTremolo &ioTremolo) {
+	for (int id = 0; id < kNumberOfParameters; ++id) {
+		const ParameterRange &range = kRanges[id];
+		float value = ioValues[id];
+		if (ioRandom.Next () % range.oneIn != 0) {
+			ioTremolo.SetParameter (id, value);
+			continue;
+		}
+		if (!range.continuous) {
+			ioValues[id] = (float) ioRandom.Integer ((int) range.minimum, (int) range.maximum);
+			ioTremolo.SetParameter (id, ioValues[id]);
+			continue;
+		}
+		float target = range.minimum + ioRandom.Uniform () * (range.maximum - range.minimum);
+		if (ioRandom.Next () & 1) {
+			ioTremolo.RampParameter (id, value, (target - value)/inFrames, inFrames);
+		} else {
+			ioTremolo.SetParameter (id, target);
+		}
+		ioValues[id] = target;
+	}
+}
+
+static float DefaultValue (int inID) {
+	static const float defaults[kNumberOfParameters] = {
+		kDefaultValue_Length, kDefaultValue_Direction, kDefaultValue_Mix, kDefaultValue_Signature,
+		kDefaultValue_Speed, kDefaultValue_Depth, kDefaultValue_Delay_Power, kDefaultValue_Delay_Power_Scale,
+		kDefaultValue_Ring_Direction, kDefaultValue_Ring_Mix, kDefaultValue_Ring, kDefaultValue_Ring_Signature,
+		kDefaultValue_Ring_Speed, kDefaultValue_Ring_Depth, kDefaultValue_Signal_Power_Direction,
+		kDefaultValue_Signal_Power, kDefaultValue_Signal_Power_Scale, kDefaultValue_Signal_Power_Signature,
+		kDefaultValue_Signal_Power_Speed, kDefaultValue_Signal_Power_Depth, kDefaultValue_Fade, kDefaultValue_Duck
+	};
+	return defaults[inID];
+}
+
+#pragma mark ____Render
+
+struct Options {
+	int				blockFrames = 512;
+	double			tolerance = -1;		// -1 picks the default for the comparison
+	bool			linked = true;
+	bool			skipsSilence = false;
+	bool			restoresSnapshot = false;
+	const char		*recordDirectory = NULL;
+	const char		*goldenDirectory = NULL;
+};
+
+// Renders inStimulus through the engine into outEngine and, unless outReference is NULL,
+//  through one TremoloReference a channel into outReference; false when out of memory.
+static bool Render (const Stimulus &inStimulus, const Options &inOptions,
+					std::vector<float> &outEngine, std::vector<float> *outReference) {
+	const int channels = inStimulus.channels;
+	const long frames = inStimulus.Frames ();
+	const int maxBlock = inStimulus.automationSeed ? 2048 : inOptions.blockFrames;
+
+	OfflineTremolo tremolo (inOptions.linked);
+	tremolo.SetSkipsSilence (inOptions.skipsSilence);
+	float values[kNumberOfParameters];
+	for (int id = 0; id < kNumberOfParameters; ++id) values[id] = DefaultValue (id);
+	for (size_t p = 0; p < inStimulus.parameters.size (); ++p) values[inStimulus.parameters[p].first] = inStimulus.parameters[p].second;
+	for (int id = 0; id < kNumberOfParameters; ++id) tremolo.SetParameter (id, values[id]);
+	if (!tremolo.Prepare (channels, inStimulus.sampleRate, 120, maxBlock)) return false;
+
+	std::vector<std::unique_ptr<TremoloReference> > references;
+	if (outReference != NULL) {
+		for (int c = 0; c < channels; ++c) {
+			references.push_back (std::unique_ptr<TremoloReference> (new TremoloReference (&tremolo.Parameters (), tremolo.Capacity ())));
+		}
+		outReference->resize (inStimulus.samples.size ());
+	}
+	outEngine.resize (inStimulus.samples.size ());
+
+	Random random (inStimulus.automationSeed);
+	bool snapshotPending = inOptions.restoresSnapshot;
+	for (long start = 0; start < frames; ) {
+		int block = inStimulus.automationSeed ? random.Integer (1, maxBlock) : maxBlock;
+		if (block > frames - start) block = (int) (frames - start);
+		if (inStimulus.automationSeed) Automate (random, values, block, tremolo);
+
+		if (snapshotPending && start >= frames/2) {
+			std::vector<unsigned char> state;
+			tremolo.SaveState (state);
+			if (!tremolo.Prepare (channels, inStimulus.sampleRate, 120, maxBlock)) return false;
+			if (!tremolo.RestoreState (state)) {
+				fprintf (stderr, "tremolo-golden: %s: the snapshot didn't restore\n", inStimulus.name.c_str ());
+				exit (1);
+			}
+			snapshotPending = false;
+		}
+
+		size_t offset = (size_t) start * channels;
+		tremolo.Process (&inStimulus.samples[offset], &outEngine[offset], block);
+		for (int c = 0; c < (int) references.size (); ++c) {
+			references[c]->Process (&inStimulus.samples[offset + c], &(*outReference)[offset + c], channels, block);
+		}
+		start += block;
+	}
+	return true;
+}
+
+#pragma mark ____Compare
+
+struct Comparison {
+	double	maxError = 0;
+	double	rmsError = 0;
+	long	firstDivergence = -1;	// frame, or -1
+};
+
+// NaNs match each other and nothing else; infinities match only themselves
+static Comparison Compare (const std::vector<float> &inActual, const std::vector<float> &inExpected,
+						   int inChannels, double inTolerance) {
+	Comparison result;
+	double sumOfSquares = 0;
+	size_t count = std::min (inActual.size (), inExpected.size ());
+	for (size_t i = 0; i < count; ++i) {
+		float actual = inActual[i], expected = inExpected[i];
+		double error;
+		if (actual == expected || (isnan (actual) && isnan (expected))) error = 0;
+		else error = fabs ((double) actual - expected);
+		if (isnan (error)) error = INFINITY;
+
+		if (error > result.maxError) result.maxError = error;
+		if (!isinf (error)) sumOfSquares += error*error;
+		double allowed = inTolerance * fmax (1.0, fabs ((double) expected));
+		if (result.firstDivergence < 0 && !(error <= allowed)) result.firstDivergence = (long) (i / inChannels);
+	}
+	if (inActual.size () != inExpected.size () && result.firstDivergence < 0) result.firstDivergence = (long) (count / inChannels);
+	result.rmsError = count ? sqrt (sumOfSquares / count) : 0;
+	return result;
+}
+
+static std::string GoldenPath (const char *inDirectory, const Stimulus &inStimulus) {
+	return std::string (inDirectory) + "/" + inStimulus.name + ".wav";
+}
+
+#pragma mark ____main
+
+static void Usage () {
+	fprintf (stderr, "usage: tremolo-golden [-b frames] [-t tolerance] [-x] [-u] [-s] [-k] [-r dir | -g dir] [<input>...]\n");
+	exit (2);
+}
+
+int main (int argc, char *argv[]) {
+	Options options;
+	int i = 1;
+	for (; i < argc && argv[i][0] == '-'; ++i) {
+		if (strcmp (argv[i], "-b") == 0 && i + 1 < argc) options.blockFrames = atoi (argv[++i]);
+		else if (strcmp (argv[i], "-t") == 0 && i + 1 < argc) options.tolerance = atof (argv[++i]);
+		else if (strcmp (argv[i], "-x") == 0) options.tolerance = 0;
+		else if (strcmp (argv[i], "-u") == 0) options.linked = false;
+		else if (strcmp (argv[i], "-s") == 0) options.skipsSilence = true;
+		else if (strcmp (argv[i], "-k") == 0) options.restoresSnapshot = true;
+		else if (strcmp (argv[i], "-r") == 0 && i + 1 < argc) options.recordDirectory = argv[++i];
+		else if (strcmp (argv[i], "-g") == 0 && i + 1 < argc) options.goldenDirectory = argv[++i];
+		else Usage ();
+	}
+	if (options.blockFrames < 1 || (options.recordDirectory && options.goldenDirectory)) Usage ();
+	if (options.tolerance < 0) options.tolerance = options.goldenDirectory ? 0 : 1e-4;
+
+	std::vector<Stimulus> stimuli;
+	stimuli.push_back (Impulses (44100, 12, 0.75));
+	stimuli.push_back (Sweep (48000, 10));
+	stimuli.back ().parameters.push_back (std::make_pair ((int) kParameter_Length, 2.0f));
+	stimuli.back ().parameters.push_back (std::make_pair ((int) kParameter_Direction, (float) kForward_Direction));
+	stimuli.back ().parameters.push_back (std::make_pair ((int) kParameter_Ring_Direction, (float) kBackward_Ring_Direction));
+	stimuli.back ().parameters.push_back (std::make_pair ((int) kParameter_Signal_Power_Direction, (float) kBackward_Signal_Power_Direction));
+	// short lines, so each tail dies away well inside its gap
+	stimuli.push_back (Bursts (44100, 3, 0.5, 5));
+	stimuli.back ().parameters.push_back (std::make_pair ((int) kParameter_Length, (float) kMinimumValue_Length));
+	stimuli.back ().parameters.push_back (std::make_pair ((int) kParameter_Signature, (float) kMaximumValue_Signature));
+	stimuli.back ().parameters.push_back (std::make_pair ((int) kParameter_Speed, (float) kMaximumValue_Speed));
+	stimuli.push_back (Automation ("automation", 44100, 20, 1));
+	stimuli.push_back (Automation ("automation-96k", 96000, 10, 2));
+	for (; i < argc; ++i) {
+		stimuli.push_back (Stimulus ());
+		if (!LoadFile (argv[i], stimuli.back ())) return 1;
+	}
+
+	const char *against = options.goldenDirectory ? "golden" : options.recordDirectory ? NULL : "reference";
+	bool failed = false;
+	for (size_t s = 0; s < stimuli.size (); ++s) {
+		const Stimulus &stimulus = stimuli[s];
+		std::vector<float> engine, expected;
+		if (!Render (stimulus, options, engine, (against != NULL && options.goldenDirectory == NULL) ? &expected : NULL)) {
+			fprintf (stderr, "tremolo-golden: out of memory\n");
+			return 1;
+		}
+
+		if (options.recordDirectory) {
+			AudioFileWriter writer;
+			std::string path = GoldenPath (options.recordDirectory, stimulus);
+			if (!writer.Open (path.c_str (), stimulus.channels, stimulus.sampleRate)
+				|| !writer.Write (&engine[0], stimulus.Frames ()) || !writer.Close ()) {
+				fprintf (stderr, "tremolo-golden: can't write %s\n", path.c_str ());
+				return 1;
+			}
+			printf ("%-36s recorded %s\n", stimulus.name.c_str (), path.c_str ());
+			continue;
+		}
+
+		if (options.goldenDirectory) {
+			Stimulus golden;
+			std::string path = GoldenPath (options.goldenDirectory, stimulus);
+			if (!LoadFile (path.c_str (), golden)) return 1;
+			expected.swap (golden.samples);
+		}
+
+		Comparison comparison = Compare (engine, expected, stimulus.channels, options.tolerance);
+		bool passed = comparison.firstDivergence < 0;
+		failed = failed || !passed;
+		char divergence[32] = "-";
+		if (!passed) snprintf (divergence, sizeof (divergence), "%ld", comparison.firstDivergence);
+		printf ("%-36s %d ch %8ld frames  max %.3g  rms %.3g  first divergence %s  %s\n",
+				stimulus.name.c_str (), stimulus.channels, stimulus.Frames (), comparison.maxError,
+				comparison.rmsError, divergence, passed ? "ok" : "FAILED");
+	}
+	if (against != NULL) printf ("%s against %s, tolerance %g\n", failed ? "FAILED" : "passed", against, options.tolerance);
+	return failed ? 1 : 0;
+}
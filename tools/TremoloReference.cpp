@@ -0,0 +1,147 @@
+/*
+Abstract:
+Scalar reference implementation of the commdelay DSP
+*/
+
+// This file defines the TremoloReference class. Changes to TremoloCore that are meant to
+//  change the sound should be made here as well, in the plainest form that works.
+
+#include "TremoloReference.h"
+
+#include <algorithm>
+
+static const float pi = 3.14159265358979f;
+
+// the fade envelope of a head, ducked
+static inline float Envelope (int inFade, int inDuck, int inHead, int inRate) {
+	float mod;
+	if (inFade == 0) mod = 1;
+	else mod = inFade*sinf (pi*inHead/inRate);
+	if (mod < 0) mod = 0;
+	else if (mod > 1) mod = 1;
+	return (inDuck*mod + 1)/(inDuck + 1);
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	TremoloReference::TremoloReference
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+TremoloReference::TremoloReference (const TremoloParameters *inParameters, long inCapacity)
+	: mParameters (inParameters),
+	  mCapacity ((int) inCapacity),
+	  lastDelay (inCapacity), delay (inCapacity),
+	  lastRingDelay (inCapacity), ringDelay (inCapacity),
+	  lastSignalPowerDelay (inCapacity), signalPowerDelay (inCapacity)
+{
+	lastRate = std::min (lastRate, mCapacity);
+	lastRingRate = std::min (lastRingRate, mCapacity);
+	lastSignalPowerRate = std::min (lastSignalPowerRate, mCapacity);
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	TremoloReference::Reset
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void TremoloReference::Reset () {
+	head = 0;
+	rhead = 0;
+	phead = 0;
+
+	std::fill (lastDelay.begin (), lastDelay.end (), 0.0f);
+	std::fill (delay.begin (), delay.end (), 0.0f);
+	std::fill (lastRingDelay.begin (), lastRingDelay.end (), 0.0f);
+	std::fill (ringDelay.begin (), ringDelay.end (), 0.0f);
+	std::fill (lastSignalPowerDelay.begin (), lastSignalPowerDelay.end (), 0.0f);
+	std::fill (signalPowerDelay.begin (), signalPowerDelay.end (), 0.0f);
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	TremoloReference::Process
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void TremoloReference::Process (const float *inSource, float *outDest, int inStride, int inFrames) {
+	const TremoloParameters &p = *mParameters;
+	const float *sourceP = inSource;
+	float *destP = outDest;
+
+	float	mix = p.mix,
+			depth = p.depth,
+			delayPowerScale = p.delayPowerScale,
+			ringMix = p.ringMix,
+			ring = p.ring,
+			ringDepth = p.ringDepth,
+			signalPowerScale = p.signalPowerScale,
+			signalPowerDepth = p.signalPowerDepth;
+
+	int n = inFrames;
+	while (n--) {
+		if (head == 0) {
+			if (p.samplesPerDelay != lastRate) {
+				lastRate = p.samplesPerDelay;
+				std::fill (lastDelay.begin (), lastDelay.end (), 0.0f);
+				std::fill (delay.begin (), delay.end (), 0.0f);
+			}
+			if (p.samplesPerRingDelay != lastRingRate) {
+				lastRingRate = p.samplesPerRingDelay;
+				rhead %= lastRingRate;
+				std::fill (lastRingDelay.begin (), lastRingDelay.end (), 0.0f);
+				std::fill (ringDelay.begin (), ringDelay.end (), 0.0f);
+			}
+			if (p.samplesPerSignalPowerDelay != lastSignalPowerRate) {
+				lastSignalPowerRate = p.samplesPerSignalPowerDelay;
+				phead %= lastSignalPowerRate;
+				std::fill (lastSignalPowerDelay.begin (), lastSignalPowerDelay.end (), 0.0f);
+				std::fill (signalPowerDelay.begin (), signalPowerDelay.end (), 0.0f);
+			}
+			lastDirection = p.direction;
+			lastRingDirection = p.ringDirection;
+		}
+
+		float last = *sourceP;
+		sourceP += inStride;
+
+		float mod = Envelope (p.fade, p.duck, head, lastRate);
+		float pmod = Envelope (p.fade, p.duck, phead, lastSignalPowerRate);
+
+		delay[head] = (delay[(lastRate+head-1)%lastRate] + delay[head] + delay[(head+1)%lastRate])/3;
+		ringDelay[rhead] = (ringDelay[(lastRingRate+rhead-1)%lastRingRate] + ringDelay[rhead]
+							+ ringDelay[(rhead+1)%lastRingRate])/3;
+		signalPowerDelay[phead] = (signalPowerDelay[(lastSignalPowerRate+phead-1)%lastSignalPowerRate]
+									+ signalPowerDelay[phead]
+									+ signalPowerDelay[(phead+1)%lastSignalPowerRate])/3;
+
+		*destP = (1-ringMix)*((1-mix)*last + mod*mix*delay[head])
+					+ ringMix*(
+							ring*(ringDelay[head]*ringDelay[(lastRingRate-rhead)%lastRingRate])
+							+ mod*powf (delayPowerScale*delay[head], p.delayPower)
+							+ pmod*powf (signalPowerScale*signalPowerDelay[phead], p.signalPower)
+							);
+		destP += inStride;
+
+		head = (head+1)%lastRate;
+		rhead = (rhead+1)%lastRingRate;
+		phead = (phead+1)%lastSignalPowerRate;
+
+		int dhead = (lastDirection > 0) ? head : (lastRate-head)%lastRate;
+		int rdhead = (lastRingDirection > 0) ? rhead : (lastRingRate-rhead)%lastRingRate;
+		int pdhead = (p.signalPowerDirection > 0) ? phead : (lastSignalPowerRate-phead)%lastSignalPowerRate;
+
+		// write delay line
+		lastDelay[dhead] = (lastDelay[(lastRate+dhead-1)%lastRate] + last + lastDelay[(dhead+1)%lastRate])/3;
+		delay[dhead] = lastDelay[dhead] + depth*delay[dhead];
+		// write ring delay line
+		lastRingDelay[rdhead] = (lastRingDelay[(lastRingRate+rdhead-1)%lastRingRate] + last
+									+ lastRingDelay[(rdhead+1)%lastRingRate])/3;
+		ringDelay[rdhead] = lastRingDelay[rdhead] + ringDepth*ringDelay[rdhead];
+		// write exponent delay line
+		lastSignalPowerDelay[pdhead] = (lastSignalPowerDelay[(lastSignalPowerRate+pdhead-1)%lastSignalPowerRate] + last
+										+ lastSignalPowerDelay[(pdhead+1)%lastSignalPowerRate])/3;
+		signalPowerDelay[pdhead] = lastSignalPowerDelay[pdhead] + signalPowerDepth*signalPowerDelay[pdhead];
+
+		mix += p.rampStep[kParameter_Mix];
+		depth += p.rampStep[kParameter_Depth];
+		delayPowerScale += p.rampStep[kParameter_Delay_Power_Scale];
+		ringMix += p.rampStep[kParameter_Ring_Mix];
+		ring += p.rampStep[kParameter_Ring];
+		ringDepth += p.rampStep[kParameter_Ring_Depth];
+		signalPowerScale += p.rampStep[kParameter_Signal_Power_Scale];
+		signalPowerDepth += p.rampStep[kParameter_Signal_Power_Depth];
+	}
+}
@@ -0,0 +1,58 @@
+/*
+Abstract:
+Scalar reference implementation of the commdelay DSP
+*/
+
+#include "TremoloCore.h"
+
+#include <vector>
+
+#ifndef __TremoloReference_h__
+#define __TremoloReference_h__
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// TremoloReference
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// The kernel's per-sample loop the way TremoloUnitKernel::Process first wrote it: one
+//  channel, modulo indexing, sinf fade envelopes, pow() for the exponents and lines that
+//  are cleared in full as soon as their length changes. It follows the same
+//  TremoloParameters as TremoloCore, ramps included, so the two should sound the same;
+//  tremolo-golden measures how far apart they are.
+//
+// It is kept simple on purpose and is not meant to be optimized.
+#pragma mark ____TremoloReference
+class TremoloReference {
+	public:
+		// lines of inCapacity samples, as TremoloCore gets from a TremoloDelayArena
+		TremoloReference (const TremoloParameters *inParameters, long inCapacity);
+
+		void Reset ();
+
+		// one channel; the pointers step inStride floats a frame
+		void Process (const float *inSource, float *outDest, int inStride, int inFrames);
+
+	private:
+		const TremoloParameters *mParameters;
+		int		mCapacity;
+
+		int		head = 0;
+		int		rhead = 0;
+		int		phead = 0;
+
+		std::vector<float>	lastDelay;
+		std::vector<float>	delay;
+		std::vector<float>	lastRingDelay;
+		std::vector<float>	ringDelay;
+		std::vector<float>	lastSignalPowerDelay;
+		std::vector<float>	signalPowerDelay;
+
+		// the same starting lengths and directions as TremoloCore
+		int		lastRate = 4096*4;
+		int		lastRingRate = 2048*3;
+		int		lastSignalPowerRate = 1024*5;
+
+		int		lastDirection = 1;
+		int		lastRingDirection = 1;
+};
+
+#endif
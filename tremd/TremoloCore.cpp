@@ -0,0 +1,1212 @@
+/*
+Copyright (C) 2016 Apple Inc. All Rights Reserved.
+See LICENSE.txt for this sample’s licensing information
+
+Abstract:
+Tremolo Effect DSP, shared by the AU and the offline tools
+*/
+
+// This file defines the TremoloCore class, which TremoloUnit's kernels render with, and the
+//  parameter and delay arena helpers they share.
+
+#include "TremoloCore.h"
+
+#pragma mark ____DelayPathConfig
+
+// What each delay path takes from the parameters. The paths are otherwise alike, down to
+//  the work done on them every frame, and TremoloCore keeps their state in arrays indexed
+//  by path; only the output mix reads them differently. The main and ring paths take up
+//  a new direction when the main head wraps, and the signal power path at every buffer,
+//  as the kernel always has.
+struct DelayPathConfig {
+	int		TremoloParameters::*samples;	// the derived length in frames
+	int		TremoloParameters::*signature;
+	int		TremoloParameters::*speed;
+	int		TremoloParameters::*direction;
+	float	TremoloParameters::*depth;		// the feedback
+	int		depthParameter;					// the ID the depth ramps under
+	bool	latchesDirection;
+};
+
+static const DelayPathConfig kDelayPathConfigs[kDelayPaths] = {
+	{	&TremoloParameters::samplesPerDelay, &TremoloParameters::signature, &TremoloParameters::speed,
+		&TremoloParameters::direction, &TremoloParameters::depth, kParameter_Depth, true },
+	{	&TremoloParameters::samplesPerRingDelay, &TremoloParameters::ringSignature, &TremoloParameters::ringSpeed,
+		&TremoloParameters::ringDirection, &TremoloParameters::ringDepth, kParameter_Ring_Depth, true },
+	{	&TremoloParameters::samplesPerSignalPowerDelay, &TremoloParameters::signalPowerSignature, &TremoloParameters::signalPowerSpeed,
+		&TremoloParameters::signalPowerDirection, &TremoloParameters::signalPowerDepth, kParameter_Signal_Power_Depth, false }
+};
+
+#pragma mark ____TremoloParameters
+
+static inline float ClampParameter (float inValue, float inMinimum, float inMaximum) {
+	if (inValue < inMinimum) return inMinimum;
+	if (inValue > inMaximum) return inMaximum;
+	return inValue;
+}
+
+// clamps both ends of a ramp of inFrames frames, returns its start and leaves its
+//  per-frame step in outStep
+static inline float RampParameter (
+	float	inValue,
+	float	inStep,
+	uint32_t	inFrames,
+	float	inMinimum,
+	float	inMaximum,
+	float	&outStep
+) {
+	float start = ClampParameter (inValue, inMinimum, inMaximum);
+	float end = ClampParameter (inValue + inStep*inFrames, inMinimum, inMaximum);
+	outStep = (inFrames > 0) ? (end - start)/inFrames : 0;
+	return start;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	TremoloParameters::Apply
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void TremoloParameters::Apply (int inID, float inValue, float inStep, uint32_t inFrames) {
+	float &step = rampStep[inID];
+	switch (inID) {
+		case kParameter_Length:
+			length = (int) ClampParameter (inValue, kMinimumValue_Length, kMaximumValue_Length);
+			break;
+		case kParameter_Direction:
+			direction = ((int) inValue == kForward_Direction) ? 1 : -1;
+			break;
+		case kParameter_Mix:
+			mix = RampParameter (inValue, inStep, inFrames, kMinimumValue_Mix, kMaximumValue_Mix, step);
+			break;
+		case kParameter_Signature:
+			signature = (int) ClampParameter (inValue, kMinimumValue_Signature, kMaximumValue_Signature);
+			break;
+		case kParameter_Speed:
+			speed = (int) ClampParameter (inValue, kMinimumValue_Speed, kMaximumValue_Speed);
+			break;
+		case kParameter_Depth:
+			depth = RampParameter (inValue, inStep, inFrames, kMinimumValue_Depth, kMaximumValue_Depth, step);
+			break;
+		case kParameter_Delay_Power:
+			delayPower = (int) ClampParameter (inValue, kMinimumValue_Delay_Power, kMaximumValue_Delay_Power);
+			break;
+		case kParameter_Delay_Power_Scale:
+			delayPowerScale = RampParameter (inValue, inStep, inFrames, kMinimumValue_Delay_Power_Scale, kMaximumValue_Delay_Power_Scale, step);
+			break;
+			
+		case kParameter_Ring_Direction:
+			ringDirection = ((int) inValue == kForward_Ring_Direction) ? 1 : -1;
+			break;
+		case kParameter_Ring_Mix:
+			ringMix = RampParameter (inValue, inStep, inFrames, kMinimumValue_Ring_Mix, kMaximumValue_Ring_Mix, step);
+			break;
+		case kParameter_Ring:
+			ring = RampParameter (inValue, inStep, inFrames, kMinimumValue_Ring, kMaximumValue_Ring, step);
+			break;
+		case kParameter_Ring_Signature:
+			ringSignature = (int) ClampParameter (inValue, kMinimumValue_Ring_Signature, kMaximumValue_Ring_Signature);
+			break;
+		case kParameter_Ring_Speed:
+			ringSpeed = (int) ClampParameter (inValue, kMinimumValue_Ring_Speed, kMaximumValue_Ring_Speed);
+			break;
+		case kParameter_Ring_Depth:
+			ringDepth = RampParameter (inValue, inStep, inFrames, kMinimumValue_Ring_Depth, kMaximumValue_Ring_Depth, step);
+			break;
+			
+		case kParameter_Signal_Power_Direction:
+			signalPowerDirection = ((int) inValue == kForward_Signal_Power_Direction) ? 1 : -1;
+			break;
+		case kParameter_Signal_Power:
+			signalPower = (int) ClampParameter (inValue, kMinimumValue_Signal_Power, kMaximumValue_Signal_Power);
+			break;
+		case kParameter_Signal_Power_Scale:
+			signalPowerScale = RampParameter (inValue, inStep, inFrames, kMinimumValue_Signal_Power_Scale, kMaximumValue_Signal_Power_Scale, step);
+			break;
+		case kParameter_Signal_Power_Signature:
+			signalPowerSignature = (int) ClampParameter (inValue, kMinimumValue_Signal_Power_Signature, kMaximumValue_Signal_Power_Signature);
+			break;
+		case kParameter_Signal_Power_Speed:
+			signalPowerSpeed = (int) ClampParameter (inValue, kMinimumValue_Signal_Power_Speed, kMaximumValue_Signal_Power_Speed);
+			break;
+		case kParameter_Signal_Power_Depth:
+			signalPowerDepth = RampParameter (inValue, inStep, inFrames, kMinimumValue_Signal_Power_Depth, kMaximumValue_Signal_Power_Depth, step);
+			break;
+			
+		case kParameter_Fade:
+			fade = (int) ClampParameter (inValue, kMinimumValue_Fade, kMaximumValue_Fade);
+			break;
+		case kParameter_Duck:
+			duck = (int) ClampParameter (inValue, kMinimumValue_Duck, kMaximumValue_Duck);
+			break;
+	}
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	TremoloParameters::DelayLengthsDiffer
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+bool TremoloParameters::DelayLengthsDiffer (const TremoloParameters &inOther) const {
+	if (length != inOther.length) return true;
+	for (int p = 0; p < kDelayPaths; ++p) {
+		const DelayPathConfig &path = kDelayPathConfigs[p];
+		if (this->*path.signature != inOther.*path.signature || this->*path.speed != inOther.*path.speed) return true;
+	}
+	return false;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	TremoloParameters::UpdateDelayLengths
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void TremoloParameters::UpdateDelayLengths (double inSampleRate, double inBeatsPerSecond, long inCapacity, int inDecimation) {
+	double samplesPerBeatLength = inSampleRate * length / inBeatsPerSecond;
+	int capacity = (int) (inCapacity > inDecimation ? inCapacity : inDecimation);
+	for (int p = 0; p < kDelayPaths; ++p) {
+		const DelayPathConfig &path = kDelayPathConfigs[p];
+		int samples = (int) (samplesPerBeatLength / (this->*path.signature * this->*path.speed));
+		if (samples < inDecimation) samples = inDecimation;
+		if (samples > capacity) samples = capacity;
+		this->*path.samples = samples - samples % inDecimation;
+	}
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	TremoloParameters::TailSeconds
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Three passes more than the decay needs: the one the input stopped in, and the two the
+//  peaks a LazyDelayLinePair keeps take to catch up.
+double TremoloParameters::TailSeconds (double inSampleRate) const {
+	double tail = 0;
+	for (int p = 0; p < kDelayPaths; ++p) {
+		const DelayPathConfig &path = kDelayPathConfigs[p];
+		double feedback = this->*path.depth;
+		double decay = (feedback > 2.0/3) ? feedback : 2.0/3;
+		double passes = (decay < 1) ? ceil (log (kSilenceThreshold)/log (decay)) + 3 : kMaximumTailPasses;
+		if (passes > kMaximumTailPasses) passes = kMaximumTailPasses;
+		double seconds = passes * (this->*path.samples) / inSampleRate;
+		if (seconds > tail) tail = seconds;
+	}
+	return tail;
+}
+
+#pragma mark ____TremoloDelayArena
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	TremoloDelayArena::CapacityFor
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+long TremoloDelayArena::CapacityFor (double inSampleRate, int inDecimation) {
+	double longestDelay = inSampleRate * kMaximumValue_Length / (kMinimumBeatsPerSecond * kMinimumValue_Signature * kMinimumValue_Speed);
+	long capacity = (long) ceil (longestDelay / inDecimation);
+	if (capacity > maxDelaySamples) capacity = maxDelaySamples;
+	if (capacity < 1) capacity = 1;
+	return capacity * inDecimation;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	TremoloDelayArena::DecimationFor
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+int TremoloDelayArena::DecimationFor (double inSampleRate) {
+	int decimation = 1;
+	while (inSampleRate / decimation > 96000 && decimation < kMaximumDecimation) decimation *= 2;
+	return decimation;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	TremoloDelayArena::Allocate
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Pads each line out to a whole number of clear chunks (and so of cache lines), which
+//  keeps every line aligned and lets the last chunk be zeroed without bounds checks.
+bool TremoloDelayArena::Allocate (long inCapacity, size_t inLineSets, int inLanes, int inDecimation) {
+	Free ();
+	
+	long stored = (inCapacity + inDecimation - 1) / inDecimation;
+	long lineStride = (stored + kClearChunkSamples - 1) & ~(kClearChunkSamples - 1);
+	size_t alignment = kDelayLineAlignment * sizeof (float);
+	size_t bytes = inLineSets * inLanes * kDelayLinesPerKernel * lineStride * sizeof (TremoloLineSample) + alignment;
+	
+	memory = calloc (bytes, 1);
+	if (memory == NULL) return false;
+	
+	uintptr_t alignMask = alignment - 1;
+	storage = (TremoloLineSample *) (((uintptr_t) memory + alignMask) & ~alignMask);
+	capacity = inCapacity;
+	stride = lineStride;
+	decimation = inDecimation;
+	return true;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	TremoloDelayArena::Free
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void TremoloDelayArena::Free () {
+	free (memory);
+	memory = NULL;
+	storage = NULL;
+	capacity = 0;
+	stride = 0;
+	decimation = 1;
+}
+
+#pragma mark ____TremoloCore
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	TremoloCore::TremoloCore
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+TremoloCore::TremoloCore (const TremoloParameters *inParameters) : mParameters (inParameters) {
+    for (int p = 0; p < kDelayPaths; ++p) mEnvelopes[p].Start(mHeads[p], mRates[p]);
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	TremoloCore::LanesFor
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+int TremoloCore::LanesFor (int inChannels) {
+	int lanes = 1;
+	while (lanes < inChannels) lanes <<= 1;
+	return lanes;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	TremoloCore::SetDelayStorage()
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// The storage arrives zeroed from the arena, so every chunk starts out current at
+//  generation 0 and there is nothing to clear here.
+void TremoloCore::SetDelayStorage (TremoloLineSample *inStorage, long inStride, long inCapacity, int inLanes, int inDecimation) {
+    mDelayCapacity = (inStorage != NULL) ? inCapacity : 0;
+    mLanes = inLanes;
+    mDecimationShift = (inDecimation >= 4) ? 2 : (inDecimation >= 2) ? 1 : 0;
+    for (int c = 0; c < kMaxLinkedLanes; ++c) mGroupInput[c] = 0;
+    
+    long chunksPerLine = inStride >> kClearChunkShift;
+    mChunkStamps.assign (kDelayPaths*chunksPerLine, 0);
+    
+    for (int p = 0; p < kDelayPaths; p++) {
+        LazyDelayLinePair &lines = mLines[p];
+        lines.last          = (inStorage != NULL) ? inStorage + (2*p)*inStride*inLanes : NULL;
+        lines.line          = (inStorage != NULL) ? inStorage + (2*p + 1)*inStride*inLanes : NULL;
+        lines.stamps        = (chunksPerLine > 0) ? &mChunkStamps[p*chunksPerLine] : NULL;
+        lines.generation    = 0;
+        lines.width         = inLanes;
+    }
+    if (inStorage == NULL) return;
+    
+    // the initial lengths are multiples of kMaximumDecimation, and so is the capacity
+    for (int p = 0; p < kDelayPaths; p++) {
+        if (mRates[p] > mDelayCapacity) mRates[p] = mDelayCapacity;
+        mHeads[p] = 0;
+        mEnvelopes[p].Start(mHeads[p], mRates[p]);
+    }
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	TremoloCore::Reset()
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void TremoloCore::Reset() {
+    for (int p = 0; p < kDelayPaths; ++p) {
+        mHeads[p] = 0;
+        mLines[p].Clear();
+        mEnvelopes[p].Restart();
+    }
+    for (int c = 0; c < kMaxLinkedLanes; ++c) mGroupInput[c] = 0;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	TremoloCore::ProcessChannels
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void TremoloCore::ProcessChannels (
+	const float *const		*inSources,
+	float *const			*inDests,
+	int						inChannels,
+	int						inStride,
+	int						inFrames
+) {
+    if (mLines[kMainPath].last == NULL) return;
+    
+    // the parameters were read and clamped once for all channels (in
+    //  TremoloUnit::UpdateParameters, for the AU); the exponents are fixed for the whole buffer,
+    //  so pick the loop compiled for them and for the number of lanes
+    const TremoloParameters &parameters = *mParameters;
+    FrameProcessor processFrames = SelectFrameProcessor(parameters.delayPower, parameters.signalPower, mLanes, mDecimationShift > 0);
+    (this->*processFrames)(inSources, inDests, inChannels, inStride, inFrames, parameters);
+}
+
+// the larger end of a parameter ramping by inStep a frame over inFrames frames
+static inline float RampPeak (float inValue, float inStep, int inFrames) {
+    float end = inValue + inStep*inFrames;
+    return (end > inValue) ? end : inValue;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	TremoloCore::IsSilent
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// The lines are checked first, from the peaks each pair keeps: what they could add to the
+//  output with every envelope at its peak and every ramp at its larger end. The input is
+//  only read once that is below the threshold.
+bool TremoloCore::IsSilent (
+	const float *const		*inSources,
+	int						inChannels,
+	int						inStride,
+	int						inFrames
+) const {
+    if (mLines[kMainPath].last == NULL) return true;
+    
+    const float delayResidual = mLines[kMainPath].Residual(),
+                ringResidual = mLines[kRingPath].Residual(),
+                signalPowerResidual = mLines[kSignalPowerPath].Residual();
+    if (delayResidual > 0 || ringResidual > 0 || signalPowerResidual > 0) {
+        const TremoloParameters &parameters = *mParameters;
+        const float *rampStep = parameters.rampStep;
+        float mix = RampPeak(parameters.mix, rampStep[kParameter_Mix], inFrames),
+              delayPowerScale = RampPeak(parameters.delayPowerScale, rampStep[kParameter_Delay_Power_Scale], inFrames),
+              ringMix = RampPeak(parameters.ringMix, rampStep[kParameter_Ring_Mix], inFrames),
+              ring = RampPeak(parameters.ring, rampStep[kParameter_Ring], inFrames),
+              signalPowerScale = RampPeak(parameters.signalPowerScale, rampStep[kParameter_Signal_Power_Scale], inFrames);
+        
+        float residual = mix*delayResidual
+                            + ringMix*(
+                                       ring*ringResidual*ringResidual
+                                        + powf(delayPowerScale*delayResidual, parameters.delayPower)
+                                        + powf(signalPowerScale*signalPowerResidual, parameters.signalPower)
+                                       );
+        if (residual >= kSilenceThreshold) return false;
+    }
+    
+    for (int c = 0; c < inChannels; ++c) {
+        const float *source = inSources[c];
+        for (int i = 0; i < inFrames; ++i, source += inStride) {
+            if (fabsf(*source) >= kSilenceThreshold) return false;
+        }
+    }
+    return true;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	TremoloCore::SkipFrames
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// The heads step a run at a time, so the delay lengths change where ProcessFrames would
+//  have changed them, and the envelopes start again from wherever the heads end up. The
+//  lines are cleared lazily, so this costs next to nothing however long they are.
+void TremoloCore::SkipFrames (int inFrames) {
+    if (mLines[kMainPath].last == NULL) return;
+    
+    const TremoloParameters &parameters = *mParameters;
+    int n = inFrames;
+    while (n > 0) {
+        if (mHeads[kMainPath] == 0) FollowParameters(parameters);
+        
+        int run = n;
+        for (int p = 0; p < kDelayPaths; ++p) {
+            if (run > mRates[p] - mHeads[p]) run = mRates[p] - mHeads[p];
+        }
+        for (int p = 0; p < kDelayPaths; ++p) {
+            mHeads[p] += run;
+            if (mHeads[p] == mRates[p]) mHeads[p] = 0;
+        }
+        
+        n -= run;
+    }
+    
+    for (int p = 0; p < kDelayPaths; ++p) {
+        mLines[p].Clear();
+        mEnvelopes[p].Start(mHeads[p], mRates[p]);
+    }
+    for (int c = 0; c < kMaxLinkedLanes; ++c) mGroupInput[c] = 0;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	TremoloCore::FollowParameters
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// A rate change empties the line; the clear itself is deferred chunk by chunk. The ring
+//  and exponent heads run free of the main head, so a line that just got shorter brings
+//  its head back inside it; the main head is at 0 here.
+void TremoloCore::FollowParameters (const TremoloParameters &inParameters) {
+    for (int p = 0; p < kDelayPaths; ++p) {
+        const DelayPathConfig &path = kDelayPathConfigs[p];
+        int samples = inParameters.*path.samples;
+        if (samples != mRates[p]) {
+            mRates[p] = samples;
+            mHeads[p] %= samples;
+            mLines[p].Clear();
+            mEnvelopes[p].Start(mHeads[p], mRates[p]);
+        }
+        mDirections[p] = inParameters.*path.direction;
+    }
+}
+
+// the direction a path's head runs in for the run about to start
+static inline int RunDirection (int inPath, int inLatchedDirection, const TremoloParameters &inParameters) {
+    const DelayPathConfig &path = kDelayPathConfigs[inPath];
+    return path.latchesDirection ? inLatchedDirection : inParameters.*path.direction;
+}
+
+// Converts the Lanes samples of one line index to float and back. For float lines these
+//  are copies the compiler drops; with F16C, half lines convert four lanes at a time.
+template <int Lanes>
+static inline void LoadLineLanes (float *outValue, const TremoloLineSample *inSamples) {
+#if TREMOLO_LINE_STORAGE == 1 && defined (__F16C__)
+    if (Lanes == 8) {
+        _mm256_storeu_ps(outValue, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *) inSamples)));
+        return;
+    }
+    if (Lanes == 4) {
+        _mm_storeu_ps(outValue, _mm_cvtph_ps(_mm_loadl_epi64((const __m128i *) inSamples)));
+        return;
+    }
+#endif
+    for (int c = 0; c < Lanes; ++c) outValue[c] = LoadLineSample(inSamples[c]);
+}
+
+template <int Lanes>
+static inline void StoreLineLanes (TremoloLineSample *outSamples, const float *inValue) {
+#if TREMOLO_LINE_STORAGE == 1 && defined (__F16C__)
+    if (Lanes == 8) {
+        const __m256 largest = _mm256_set1_ps(65504.0f), smallest = _mm256_set1_ps(-65504.0f);
+        __m256 value = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(inValue), smallest), largest);
+        _mm_storeu_si128((__m128i *) outSamples, _mm256_cvtps_ph(value, _MM_FROUND_TO_NEAREST_INT));
+        return;
+    }
+    if (Lanes == 4) {
+        const __m128 largest = _mm_set1_ps(65504.0f), smallest = _mm_set1_ps(-65504.0f);
+        __m128 value = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(inValue), smallest), largest);
+        _mm_storel_epi64((__m128i *) outSamples, _mm_cvtps_ph(value, _MM_FROUND_TO_NEAREST_INT));
+        return;
+    }
+#endif
+    for (int c = 0; c < Lanes; ++c) outSamples[c] = StoreLineSample(inValue[c]);
+}
+
+// Helpers for the lines of ProcessFrames, where each index holds Lanes samples, one per
+//  channel. They load every lane they read before storing any, so the compiler can treat
+//  the lanes as one vector even when the indices they are given coincide. Everything they
+//  store goes through ScrubDenormal: once the input stops, the averaging and the feedback
+//  would otherwise decay the lines into denormals, which are many times slower to work on.
+//
+// smooths the index under a head, leaving the value in outSmoothed as well, before it is
+//  rounded to the storage format
+template <int Lanes>
+static inline void SmoothLanes (float *outSmoothed, TremoloLineSample *ioCenter, const TremoloLineSample *inPrev, const TremoloLineSample *inNext) {
+    float prev[Lanes], center[Lanes], next[Lanes];
+    LoadLineLanes<Lanes>(prev, inPrev);
+    LoadLineLanes<Lanes>(center, ioCenter);
+    LoadLineLanes<Lanes>(next, inNext);
+    for (int c = 0; c < Lanes; ++c) outSmoothed[c] = ScrubDenormal((prev[c] + center[c] + next[c])/3);
+    StoreLineLanes<Lanes>(ioCenter, outSmoothed);
+}
+
+// writes the input into the smoothed line and feeds it back into the delay line, keeping
+//  the largest magnitude either store makes in ioPeak
+template <int Lanes>
+static inline void WriteLanes (
+    TremoloLineSample       *ioLast,
+    const TremoloLineSample *inLastPrev,
+    const TremoloLineSample *inLastNext,
+    TremoloLineSample       *ioLine,
+    const float             *inInput,
+    float                   inDepth,
+    float                   *ioPeak
+) {
+    float lastPrev[Lanes], lastNext[Lanes], line[Lanes], smoothed[Lanes], fed[Lanes];
+    LoadLineLanes<Lanes>(lastPrev, inLastPrev);
+    LoadLineLanes<Lanes>(lastNext, inLastNext);
+    LoadLineLanes<Lanes>(line, ioLine);
+    for (int c = 0; c < Lanes; ++c) smoothed[c] = ScrubDenormal((lastPrev[c] + inInput[c] + lastNext[c])/3);
+    for (int c = 0; c < Lanes; ++c) fed[c] = ScrubDenormal(smoothed[c] + inDepth*line[c]);
+    StoreLineLanes<Lanes>(ioLast, smoothed);
+    StoreLineLanes<Lanes>(ioLine, fed);
+    for (int c = 0; c < Lanes; ++c) {
+        float magnitude = (fabsf(fed[c]) > fabsf(smoothed[c])) ? fabsf(fed[c]) : fabsf(smoothed[c]);
+        ioPeak[c] = (magnitude > ioPeak[c]) ? magnitude : ioPeak[c];
+    }
+}
+
+// the gain a head's fade envelope gives, ducked. A fade of 0 holds the gain at 1; the
+//  loops pass inFadeBias = 1 for it and 0 otherwise, so that takes no branch.
+static inline float FadeGain (float inEnvelope, float inFade, float inFadeBias, float inDuckScale, float inDuckFloor) {
+    float gain = inFade*inEnvelope + inFadeBias;
+    if (gain < 0) gain = 0;
+    else if (gain > 1) gain = 1;
+    return inDuckScale*gain + inDuckFloor;
+}
+
+// the largest of Lanes peaks
+template <int Lanes>
+static inline float LanePeak (const float *inPeaks) {
+    float peak = inPeaks[0];
+    for (int c = 1; c < Lanes; ++c) peak = (inPeaks[c] > peak) ? inPeaks[c] : peak;
+    return peak;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	TremoloCore::ProcessFrames
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// The per-sample loop of Process, compiled once for every pair of delay and signal
+//  exponents so the powers are plain float multiplies, and for 1, 2, 4 or 8 lanes.
+//
+// The buffer is cut into runs that end where the first of the three heads wraps. Rate
+//  changes, envelope restarts and the lazy clearing of every chunk a run can reach are
+//  dealt with between runs, so inside a run the heads only count up and the few indices
+//  that can wrap do so by comparison rather than by an integer divide.
+//
+// The directions and the fade setting hold for a whole run as well. Rather than being
+//  tested every frame they enter the arithmetic: each write head is an origin plus the
+//  direction times the head (DirectedIndex), and a fade of 0 is a bias on the fade gain.
+//  That leaves the loop no branches on anything but the index wraps, which compile to
+//  selects, without compiling it again for every combination of the four settings.
+//
+// Every delay path gets the same work each frame: smooth the index under its head, step
+//  the head and its envelope, write the input and the feedback. That is one loop over the
+//  per-path arrays, which the compiler unrolls since kDelayPaths is a constant; only the
+//  output mix and the ring line's extra reads name a path.
+//
+// Linked channels share the heads, envelopes and index arithmetic, which are worked out
+//  once per frame; only the line arithmetic is done per lane. Lanes beyond inChannels
+//  repeat the first sample of channel 0 and write into a scratch float, which keeps the
+//  loop free of per-lane branches.
+template <int DelayPower, int SignalPower, int Lanes>
+void TremoloCore::ProcessFrames (
+	const float *const		*inSources,
+	float *const			*inDests,
+	int						inChannels,
+	int						inStride,
+	int						inFrames,
+	const TremoloParameters	&inParameters
+) {
+    // the loop below stores through float pointers, so keep the parameters it reads in
+    //  locals rather than have them reloaded from the shared block after every store
+    const float fade = inParameters.fade,
+                fadeBias = (inParameters.fade == 0) ? 1 : 0,
+                duckScale = inParameters.duckScale,
+                duckFloor = inParameters.duckFloor;
+    
+    // the continuous parameters may be ramping; they step once per frame, and a step of
+    //  zero leaves them exactly where they are
+    float   mix = inParameters.mix,
+            delayPowerScale = inParameters.delayPowerScale,
+            ringMix = inParameters.ringMix,
+            ring = inParameters.ring,
+            signalPowerScale = inParameters.signalPowerScale;
+    const float *rampStep = inParameters.rampStep;
+    const float mixStep = rampStep[kParameter_Mix],
+                delayPowerScaleStep = rampStep[kParameter_Delay_Power_Scale],
+                ringMixStep = rampStep[kParameter_Ring_Mix],
+                ringStep = rampStep[kParameter_Ring],
+                signalPowerScaleStep = rampStep[kParameter_Signal_Power_Scale];
+    
+    float depths[kDelayPaths], depthSteps[kDelayPaths];
+    TremoloLineSample *lastLines[kDelayPaths], *lines[kDelayPaths];
+    for (int p = 0; p < kDelayPaths; ++p) {
+        depths[p] = inParameters.*kDelayPathConfigs[p].depth;
+        depthSteps[p] = rampStep[kDelayPathConfigs[p].depthParameter];
+        lastLines[p] = mLines[p].last;
+        lines[p] = mLines[p].line;
+    }
+    
+    const float *sources[Lanes];
+    float *dests[Lanes];
+    int steps[Lanes];
+    float unusedLane;
+    for (int c = 0; c < Lanes; ++c) {
+        sources[c] = (c < inChannels) ? inSources[c] : inSources[0];
+        dests[c] = (c < inChannels) ? inDests[c] : &unusedLane;
+        steps[c] = (c < inChannels) ? inStride : 0;
+    }
+    
+    float in[Lanes] = {};
+    int n = inFrames;
+    while (n > 0) {
+        if (mHeads[kMainPath] == 0) FollowParameters(inParameters);
+        
+        // the lengths and directions are fixed for the run, so the loop takes them as data
+        int rates[kDelayPaths], directions[kDelayPaths], origins[kDelayPaths];
+        int run = n;
+        for (int p = 0; p < kDelayPaths; ++p) {
+            rates[p] = mRates[p];
+            directions[p] = RunDirection(p, mDirections[p], inParameters);
+            origins[p] = (directions[p] > 0) ? 0 : rates[p];
+            if (run > rates[p] - mHeads[p]) run = rates[p] - mHeads[p];
+        }
+        
+        // bring every chunk the run reads or writes up to date: what each head reads and
+        //  writes, and the ring line where the output also reads it, at the main head and
+        //  reflected about its own
+        for (int p = 0; p < kDelayPaths; ++p) {
+            mLines[p].TouchRun(mHeads[p], run, rates[p]);
+            mLines[p].TouchWrites(mHeads[p], run, rates[p], directions[p]);
+        }
+        mLines[kRingPath].TouchRun(rates[kRingPath] - mHeads[kRingPath] - run + 1, run, rates[kRingPath]);
+        mLines[kRingPath].TouchSpan(mHeads[kMainPath], mHeads[kMainPath] + run - 1);
+        
+        // work on local copies so the loop keeps them in registers
+        int heads[kDelayPaths];
+        HeadEnvelope envelopes[kDelayPaths];
+        float peaks[kDelayPaths][Lanes] = {};
+        for (int p = 0; p < kDelayPaths; ++p) {
+            heads[p] = mHeads[p];
+            envelopes[p] = mEnvelopes[p];
+        }
+        
+        for (int i = 0; i < run; ++i) {
+            for (int c = 0; c < Lanes; ++c) {
+                in[c] = *sources[c];
+                sources[c] += steps[c];
+            }
+            
+            // the ring line's envelope is kept running, but the output has never used it
+            const float mod = FadeGain(envelopes[kMainPath].Value(), fade, fadeBias, duckScale, duckFloor),
+                        pmod = FadeGain(envelopes[kSignalPowerPath].Value(), fade, fadeBias, duckScale, duckFloor);
+            
+            float atHead[kDelayPaths][Lanes];
+            for (int p = 0; p < kDelayPaths; ++p) {
+                const int h = heads[p], rate = rates[p];
+                SmoothLanes<Lanes>(atHead[p], lines[p] + h*Lanes, lines[p] + PrevIndex(h, rate)*Lanes, lines[p] + NextIndex(h, rate)*Lanes);
+            }
+            
+            const float *delayAtHead = atHead[kMainPath], *signalPowerDelayAtHead = atHead[kSignalPowerPath];
+            float ringDelayAtMainHead[Lanes], ringDelayReversed[Lanes];
+            LoadLineLanes<Lanes>(ringDelayAtMainHead, lines[kRingPath] + heads[kMainPath]*Lanes);
+            LoadLineLanes<Lanes>(ringDelayReversed, lines[kRingPath] + ReverseIndex(heads[kRingPath], rates[kRingPath])*Lanes);
+            float out[Lanes];
+            for (int c = 0; c < Lanes; ++c) {
+                out[c] = (1-ringMix)*((1-mix)*in[c] + mod*mix*delayAtHead[c])
+                            + ringMix*(
+                                       ring*(ringDelayAtMainHead[c]*ringDelayReversed[c])
+                                        + mod*IntPow<DelayPower>(delayPowerScale*delayAtHead[c])
+                                        + pmod*IntPow<SignalPower>(signalPowerScale*signalPowerDelayAtHead[c])
+                                       );
+            }
+            for (int c = 0; c < Lanes; ++c) {
+                *dests[c] = out[c];
+                dests[c] += steps[c];
+            }
+            
+            // the heads may reach their rate on the last sample of the run; the wrap back
+            //  to 0 happens after the loop. Each then writes the input into its lines, one
+            //  ahead of where it read or at the reflection of that.
+            for (int p = 0; p < kDelayPaths; ++p) {
+                const int h = ++heads[p], rate = rates[p];
+                envelopes[p].Advance();
+                
+                const int dh = DirectedIndex(h, origins[p], directions[p], rate);
+                WriteLanes<Lanes>(lastLines[p] + dh*Lanes, lastLines[p] + PrevIndex(dh, rate)*Lanes, lastLines[p] + NextIndex(dh, rate)*Lanes,
+                                  lines[p] + dh*Lanes, in, depths[p], peaks[p]);
+                depths[p] += depthSteps[p];
+            }
+            
+            mix += mixStep;
+            delayPowerScale += delayPowerScaleStep;
+            ringMix += ringMixStep;
+            ring += ringStep;
+            signalPowerScale += signalPowerScaleStep;
+        }
+        
+        for (int p = 0; p < kDelayPaths; ++p) {
+            mEnvelopes[p] = envelopes[p];
+            mLines[p].NotePeak(LanePeak<Lanes>(peaks[p]));
+            mHeads[p] = heads[p];
+            if (mHeads[p] == rates[p]) { mHeads[p] = 0; mEnvelopes[p].Restart(); mLines[p].EndPass(); }
+        }
+        
+        n -= run;
+    }
+    
+    if (inFrames > 0) {
+        for (int c = 0; c < inChannels; ++c) last[c] = in[c];
+    }
+}
+
+// SmoothLanes and WriteLanes for decimated lines. Of the two neighbours a full rate
+//  average takes in, one was stored the frame before and the other a pass ago; the first
+//  makes the average a one-pole low-pass of 1/3 per frame. Decimated, that neighbour is
+//  D frames old, so it is weighted by inRecentWeight = (1/3)^D to keep the same pole,
+//  and the other two share the rest, which keeps the gain at DC.
+template <int Lanes>
+static inline void SmoothDecimatedLanes (
+    TremoloLineSample       *ioCenter,
+    const TremoloLineSample *inRecent,
+    const TremoloLineSample *inOld,
+    float                   inRecentWeight
+) {
+    const float weight = (1 - inRecentWeight)/2;
+    float recent[Lanes], center[Lanes], old[Lanes], smoothed[Lanes];
+    LoadLineLanes<Lanes>(recent, inRecent);
+    LoadLineLanes<Lanes>(center, ioCenter);
+    LoadLineLanes<Lanes>(old, inOld);
+    for (int c = 0; c < Lanes; ++c) smoothed[c] = ScrubDenormal(inRecentWeight*recent[c] + weight*(center[c] + old[c]));
+    StoreLineLanes<Lanes>(ioCenter, smoothed);
+}
+
+template <int Lanes>
+static inline void WriteDecimatedLanes (
+    TremoloLineSample       *ioLast,
+    const TremoloLineSample *inLastRecent,
+    const TremoloLineSample *inLastOld,
+    TremoloLineSample       *ioLine,
+    const float             *inInput,
+    float                   inDepth,
+    float                   inRecentWeight,
+    float                   *ioPeak
+) {
+    const float weight = (1 - inRecentWeight)/2;
+    float lastRecent[Lanes], lastOld[Lanes], line[Lanes], smoothed[Lanes], fed[Lanes];
+    LoadLineLanes<Lanes>(lastRecent, inLastRecent);
+    LoadLineLanes<Lanes>(lastOld, inLastOld);
+    LoadLineLanes<Lanes>(line, ioLine);
+    for (int c = 0; c < Lanes; ++c) smoothed[c] = ScrubDenormal(inRecentWeight*lastRecent[c] + weight*(inInput[c] + lastOld[c]));
+    for (int c = 0; c < Lanes; ++c) fed[c] = ScrubDenormal(smoothed[c] + inDepth*line[c]);
+    StoreLineLanes<Lanes>(ioLast, smoothed);
+    StoreLineLanes<Lanes>(ioLine, fed);
+    for (int c = 0; c < Lanes; ++c) {
+        float magnitude = (fabsf(fed[c]) > fabsf(smoothed[c])) ? fabsf(fed[c]) : fabsf(smoothed[c]);
+        ioPeak[c] = (magnitude > ioPeak[c]) ? magnitude : ioPeak[c];
+    }
+}
+
+// the value inFraction of the way from inFrom to inTo, in every lane
+template <int Lanes>
+static inline void InterpolateLanes (float *outValue, const TremoloLineSample *inFrom, const TremoloLineSample *inTo, float inFraction) {
+    float from[Lanes], to[Lanes];
+    LoadLineLanes<Lanes>(from, inFrom);
+    LoadLineLanes<Lanes>(to, inTo);
+    for (int c = 0; c < Lanes; ++c) outValue[c] = from[c] + inFraction*(to[c] - from[c]);
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	TremoloCore::ProcessDecimatedFrames
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ProcessFrames for lines that store one sample every D = 1 << mDecimationShift frames.
+//  The heads still count frames, and every line length is a multiple of D, so all three
+//  heads are at the same point of a group of D frames: a head at frame h is at stored
+//  sample h >> shift, a fraction (h & (D - 1))/D of the way to the next.
+//
+// The line arithmetic moves to the stored rate. The mean of a group's input is written
+//  when the group ends, where the full rate loop would have written the frame after it,
+//  and smoothed when the heads come back to it at the start of the next group. The output
+//  is still rendered every frame, interpolating linearly between the last two stored
+//  samples written, so it never reads a sample the group has yet to write. That reads the
+//  lines (3D - 3)/2 frames late, but the averages' shorter lag makes up for it: the
+//  output lines up with the full rate loop's to within half a frame. A group can
+//  straddle two buffers, so its input so far is kept in mGroupInput.
+template <int DelayPower, int SignalPower, int Lanes>
+void TremoloCore::ProcessDecimatedFrames (
+	const float *const		*inSources,
+	float *const			*inDests,
+	int						inChannels,
+	int						inStride,
+	int						inFrames,
+	const TremoloParameters	&inParameters
+) {
+    const float fade = inParameters.fade,
+                fadeBias = (inParameters.fade == 0) ? 1 : 0,
+                duckScale = inParameters.duckScale,
+                duckFloor = inParameters.duckFloor;
+    
+    float   mix = inParameters.mix,
+            delayPowerScale = inParameters.delayPowerScale,
+            ringMix = inParameters.ringMix,
+            ring = inParameters.ring,
+            signalPowerScale = inParameters.signalPowerScale;
+    const float *rampStep = inParameters.rampStep;
+    const float mixStep = rampStep[kParameter_Mix],
+                delayPowerScaleStep = rampStep[kParameter_Delay_Power_Scale],
+                ringMixStep = rampStep[kParameter_Ring_Mix],
+                ringStep = rampStep[kParameter_Ring],
+                signalPowerScaleStep = rampStep[kParameter_Signal_Power_Scale];
+    
+    float depths[kDelayPaths], depthSteps[kDelayPaths];
+    TremoloLineSample *lastLines[kDelayPaths], *lines[kDelayPaths];
+    for (int p = 0; p < kDelayPaths; ++p) {
+        depths[p] = inParameters.*kDelayPathConfigs[p].depth;
+        depthSteps[p] = rampStep[kDelayPathConfigs[p].depthParameter];
+        lastLines[p] = mLines[p].last;
+        lines[p] = mLines[p].line;
+    }
+    
+    const int shift = mDecimationShift;
+    const int phaseMask = (1 << shift) - 1;
+    const float fractionPerFrame = 1.0f / (1 << shift);
+    const float recentWeight = (shift == 1) ? 1.0f/9 : 1.0f/81;	// (1/3)^D
+    
+    const float *sources[Lanes];
+    float *dests[Lanes];
+    int steps[Lanes];
+    float unusedLane;
+    for (int c = 0; c < Lanes; ++c) {
+        sources[c] = (c < inChannels) ? inSources[c] : inSources[0];
+        dests[c] = (c < inChannels) ? inDests[c] : &unusedLane;
+        steps[c] = (c < inChannels) ? inStride : 0;
+    }
+    
+    float in[Lanes], group[Lanes];
+    for (int c = 0; c < Lanes; ++c) group[c] = mGroupInput[c];
+    
+    int n = inFrames;
+    while (n > 0) {
+        if (mHeads[kMainPath] == 0) FollowParameters(inParameters);
+        
+        int rates[kDelayPaths], storedRates[kDelayPaths], directions[kDelayPaths], origins[kDelayPaths];
+        int run = n;
+        for (int p = 0; p < kDelayPaths; ++p) {
+            rates[p] = mRates[p];
+            storedRates[p] = rates[p] >> shift;
+            directions[p] = RunDirection(p, mDirections[p], inParameters);
+            origins[p] = (directions[p] > 0) ? 0 : storedRates[p];
+            if (run > rates[p] - mHeads[p]) run = rates[p] - mHeads[p];
+        }
+        
+        // bring every chunk the run reads or writes up to date; the stored samples each
+        //  head passes run from first to first + count - 1, and each run touches the
+        //  neighbours too
+        int firsts[kDelayPaths], counts[kDelayPaths];
+        for (int p = 0; p < kDelayPaths; ++p) {
+            firsts[p] = mHeads[p] >> shift;
+            counts[p] = ((mHeads[p] + run - 1) >> shift) - firsts[p] + 1;
+            mLines[p].TouchRun(firsts[p], counts[p], storedRates[p]);
+            mLines[p].TouchWrites(firsts[p], counts[p], storedRates[p], directions[p]);
+        }
+        const int ringRate = rates[kRingPath], ringHead = mHeads[kRingPath];
+        const int reversedFirst = (ringRate - ringHead - run + 2) >> shift, reversedCount = ((ringRate - ringHead + 1) >> shift) - reversedFirst + 1;
+        mLines[kRingPath].TouchRun(reversedFirst, reversedCount, storedRates[kRingPath]);
+        mLines[kRingPath].TouchRun(firsts[kMainPath], counts[kMainPath], storedRates[kMainPath]);
+        
+        int heads[kDelayPaths];
+        HeadEnvelope envelopes[kDelayPaths];
+        float peaks[kDelayPaths][Lanes] = {};
+        for (int p = 0; p < kDelayPaths; ++p) {
+            heads[p] = mHeads[p];
+            envelopes[p] = mEnvelopes[p];
+        }
+        
+        for (int i = 0; i < run; ++i) {
+            for (int c = 0; c < Lanes; ++c) {
+                in[c] = *sources[c];
+                sources[c] += steps[c];
+            }
+            
+            const float mod = FadeGain(envelopes[kMainPath].Value(), fade, fadeBias, duckScale, duckFloor),
+                        pmod = FadeGain(envelopes[kSignalPowerPath].Value(), fade, fadeBias, duckScale, duckFloor);
+            
+            // the heads share their place in the group; the samples they reached at its
+            //  start were written at the end of the previous frame, and are smoothed now
+            const int phase = heads[kMainPath] & phaseMask;
+            if (phase == 0) {
+                for (int p = 0; p < kDelayPaths; ++p) {
+                    const int k = heads[p] >> shift, storedRate = storedRates[p];
+                    SmoothDecimatedLanes<Lanes>(lines[p] + k*Lanes, lines[p] + PrevIndex(k, storedRate)*Lanes,
+                                                lines[p] + NextIndex(k, storedRate)*Lanes, recentWeight);
+                }
+            }
+            
+            // read between the last two stored samples written, see the comment above
+            const int storedRate = storedRates[kMainPath], storedRingRate = storedRates[kRingPath],
+                      storedSignalPowerRate = storedRates[kSignalPowerPath];
+            const int upper = WrapIndex((heads[kMainPath] + 1) >> shift, storedRate);
+            const int signalPowerUpper = WrapIndex((heads[kSignalPowerPath] + 1) >> shift, storedSignalPowerRate);
+            const int reversed = ReverseIndex(heads[kRingPath], ringRate) + 1, reversedUpper = WrapIndex(reversed >> shift, storedRingRate);
+            const float fraction = ((heads[kMainPath] + 1) & phaseMask) * fractionPerFrame;
+            const TremoloLineSample *delay = lines[kMainPath], *ringDelay = lines[kRingPath], *signalPowerDelay = lines[kSignalPowerPath];
+            float delayAtHead[Lanes], ringDelayAtMainHead[Lanes], ringDelayReversed[Lanes], signalPowerDelayAtHead[Lanes];
+            InterpolateLanes<Lanes>(delayAtHead, delay + PrevIndex(upper, storedRate)*Lanes, delay + upper*Lanes, fraction);
+            InterpolateLanes<Lanes>(ringDelayAtMainHead, ringDelay + PrevIndex(upper, storedRate)*Lanes, ringDelay + upper*Lanes, fraction);
+            InterpolateLanes<Lanes>(ringDelayReversed, ringDelay + PrevIndex(reversedUpper, storedRingRate)*Lanes,
+                                    ringDelay + reversedUpper*Lanes, (reversed & phaseMask) * fractionPerFrame);
+            InterpolateLanes<Lanes>(signalPowerDelayAtHead, signalPowerDelay + PrevIndex(signalPowerUpper, storedSignalPowerRate)*Lanes,
+                                    signalPowerDelay + signalPowerUpper*Lanes, fraction);
+            
+            float out[Lanes];
+            for (int c = 0; c < Lanes; ++c) {
+                out[c] = (1-ringMix)*((1-mix)*in[c] + mod*mix*delayAtHead[c])
+                            + ringMix*(
+                                       ring*(ringDelayAtMainHead[c]*ringDelayReversed[c])
+                                        + mod*IntPow<DelayPower>(delayPowerScale*delayAtHead[c])
+                                        + pmod*IntPow<SignalPower>(signalPowerScale*signalPowerDelayAtHead[c])
+                                       );
+            }
+            for (int c = 0; c < Lanes; ++c) {
+                *dests[c] = out[c];
+                dests[c] += steps[c];
+                group[c] += in[c];
+            }
+            
+            for (int p = 0; p < kDelayPaths; ++p) {
+                ++heads[p];
+                envelopes[p].Advance();
+            }
+            
+            if (phase == phaseMask) {
+                for (int c = 0; c < Lanes; ++c) {
+                    in[c] = group[c] * fractionPerFrame;
+                    group[c] = 0;
+                }
+                
+                // the group before was written on the side the head came from
+                for (int p = 0; p < kDelayPaths; ++p) {
+                    const int rate = storedRates[p], direction = directions[p];
+                    const int dk = DirectedIndex(heads[p] >> shift, origins[p], direction, rate);
+                    const int dkRecent = StepIndex(dk, -direction, rate), dkOld = StepIndex(dk, direction, rate);
+                    WriteDecimatedLanes<Lanes>(lastLines[p] + dk*Lanes, lastLines[p] + dkRecent*Lanes, lastLines[p] + dkOld*Lanes,
+                                               lines[p] + dk*Lanes, in, depths[p], recentWeight, peaks[p]);
+                }
+            }
+            
+            mix += mixStep;
+            delayPowerScale += delayPowerScaleStep;
+            ringMix += ringMixStep;
+            ring += ringStep;
+            signalPowerScale += signalPowerScaleStep;
+            for (int p = 0; p < kDelayPaths; ++p) depths[p] += depthSteps[p];
+        }
+        
+        for (int p = 0; p < kDelayPaths; ++p) {
+            mEnvelopes[p] = envelopes[p];
+            mLines[p].NotePeak(LanePeak<Lanes>(peaks[p]));
+            mHeads[p] = heads[p];
+            if (mHeads[p] == rates[p]) { mHeads[p] = 0; mEnvelopes[p].Restart(); mLines[p].EndPass(); }
+        }
+        
+        n -= run;
+    }
+    
+    for (int c = 0; c < Lanes; ++c) mGroupInput[c] = group[c];
+    if (inFrames > 0) {
+        for (int c = 0; c < inChannels; ++c) last[c] = *(sources[c] - steps[c]);
+    }
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	TremoloCore::SelectFrameProcessor
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+#define FRAME_PROCESSOR_ROW(f, d, l) { \
+	&TremoloCore::f<d, 1, l>, \
+	&TremoloCore::f<d, 2, l>, \
+	&TremoloCore::f<d, 3, l>, \
+	&TremoloCore::f<d, 4, l>, \
+	&TremoloCore::f<d, 5, l> }
+
+#define FRAME_PROCESSOR_TABLE(f, l) { \
+	FRAME_PROCESSOR_ROW(f, 1, l), \
+	FRAME_PROCESSOR_ROW(f, 2, l), \
+	FRAME_PROCESSOR_ROW(f, 3, l), \
+	FRAME_PROCESSOR_ROW(f, 4, l), \
+	FRAME_PROCESSOR_ROW(f, 5, l) }
+
+TremoloCore::FrameProcessor TremoloCore::SelectFrameProcessor (
+	int inDelayPower,
+	int inSignalPower,
+	int inLanes,
+	bool inDecimated
+) {
+	static const FrameProcessor processors[2][4][5][5] = {
+		{
+			FRAME_PROCESSOR_TABLE(ProcessFrames, 1),
+			FRAME_PROCESSOR_TABLE(ProcessFrames, 2),
+			FRAME_PROCESSOR_TABLE(ProcessFrames, 4),
+			FRAME_PROCESSOR_TABLE(ProcessFrames, 8)
+		},
+		{
+			FRAME_PROCESSOR_TABLE(ProcessDecimatedFrames, 1),
+			FRAME_PROCESSOR_TABLE(ProcessDecimatedFrames, 2),
+			FRAME_PROCESSOR_TABLE(ProcessDecimatedFrames, 4),
+			FRAME_PROCESSOR_TABLE(ProcessDecimatedFrames, 8)
+		}
+	};
+	
+	if (inDelayPower < kMinimumValue_Delay_Power) inDelayPower = kMinimumValue_Delay_Power;
+	if (inDelayPower > kMaximumValue_Delay_Power) inDelayPower = kMaximumValue_Delay_Power;
+	if (inSignalPower < kMinimumValue_Signal_Power) inSignalPower = kMinimumValue_Signal_Power;
+	if (inSignalPower > kMaximumValue_Signal_Power) inSignalPower = kMaximumValue_Signal_Power;
+	
+	int lanes = (inLanes >= 8) ? 3 : (inLanes >= 4) ? 2 : (inLanes >= 2) ? 1 : 0;
+	return processors[inDecimated ? 1 : 0][lanes][inDelayPower - 1][inSignalPower - 1];
+}
+
+#undef FRAME_PROCESSOR_TABLE
+#undef FRAME_PROCESSOR_ROW
+
+#pragma mark ____State
+
+// The fixed part of a TremoloCore snapshot. The line chunks follow it, each as a
+//  TremoloStateChunk and then its samples in the last line and in the line.
+struct TremoloStateHeader {
+	uint32_t	magic;
+	uint32_t	version;
+	int32_t		storage;				// TREMOLO_LINE_STORAGE
+	int32_t		lanes;
+	int32_t		decimationShift;
+	int32_t		chunkCount;
+	int64_t		capacity;
+	int64_t		chunksPerLine;
+	float		last[kMaxLinkedLanes];
+	float		groupInput[kMaxLinkedLanes];
+	int32_t		heads[kDelayPaths];
+	int32_t		rates[kDelayPaths];
+	int32_t		directions[kDelayPaths];
+	uint32_t	reserved;
+	float		peaks[kDelayPaths][3];
+	double		envelopes[kDelayPaths][4];	// sin, cos, sin step, cos step
+};
+
+struct TremoloStateChunk {
+	int32_t		path;
+	int32_t		chunk;
+};
+
+static const uint32_t kTremoloStateMagic = 0x54726d53;	// 'TrmS'
+static const uint32_t kTremoloStateVersion = 1;
+
+// true when the chunk was cleared this generation and something has been stored in it since
+static bool ChunkHoldsSamples (const LazyDelayLinePair &inLines, long inChunk) {
+    if (inLines.stamps[inChunk] != inLines.generation) return false;
+    size_t bytes = sizeof (TremoloLineSample) * kClearChunkSamples * inLines.width;
+    const unsigned char *last = (const unsigned char *) (inLines.last + (inChunk << kClearChunkShift) * inLines.width);
+    const unsigned char *line = (const unsigned char *) (inLines.line + (inChunk << kClearChunkShift) * inLines.width);
+    for (size_t i = 0; i < bytes; ++i) {
+        if ((last[i] | line[i]) != 0) return true;
+    }
+    return false;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	TremoloCore::StateSize
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+size_t TremoloCore::StateSize () const {
+    long chunksPerLine = (long) (mChunkStamps.size () / kDelayPaths);
+    size_t chunkBytes = sizeof (TremoloStateChunk) + 2 * sizeof (TremoloLineSample) * kClearChunkSamples * mLanes;
+    size_t size = sizeof (TremoloStateHeader);
+    if (mLines[kMainPath].last == NULL) return size;
+    
+    for (int p = 0; p < kDelayPaths; ++p) {
+        for (long chunk = 0; chunk < chunksPerLine; ++chunk) {
+            if (ChunkHoldsSamples(mLines[p], chunk)) size += chunkBytes;
+        }
+    }
+    return size;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	TremoloCore::SaveState
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// The header and chunks are copied in with memcpy, so outData needn't be aligned.
+size_t TremoloCore::SaveState (void *outData, size_t inCapacity) const {
+    size_t size = StateSize();
+    if (inCapacity < size) return 0;
+    
+    long chunksPerLine = (long) (mChunkStamps.size () / kDelayPaths);
+    size_t sampleBytes = sizeof (TremoloLineSample) * kClearChunkSamples * mLanes;
+    unsigned char *out = (unsigned char *) outData + sizeof (TremoloStateHeader);
+    
+    TremoloStateHeader header;
+    memset(&header, 0, sizeof (header));
+    header.magic = kTremoloStateMagic;
+    header.version = kTremoloStateVersion;
+    header.storage = TREMOLO_LINE_STORAGE;
+    header.lanes = mLanes;
+    header.decimationShift = mDecimationShift;
+    header.capacity = mDelayCapacity;
+    header.chunksPerLine = chunksPerLine;
+    for (int c = 0; c < kMaxLinkedLanes; ++c) {
+        header.last[c] = last[c];
+        header.groupInput[c] = mGroupInput[c];
+    }
+    for (int p = 0; p < kDelayPaths; ++p) {
+        header.heads[p] = mHeads[p];
+        header.rates[p] = mRates[p];
+        header.directions[p] = mDirections[p];
+        for (int k = 0; k < 3; ++k) header.peaks[p][k] = mLines[p].peaks[k];
+        header.envelopes[p][0] = mEnvelopes[p].sinValue;
+        header.envelopes[p][1] = mEnvelopes[p].cosValue;
+        header.envelopes[p][2] = mEnvelopes[p].sinStep;
+        header.envelopes[p][3] = mEnvelopes[p].cosStep;
+        
+        if (mLines[p].last == NULL) continue;
+        for (long chunk = 0; chunk < chunksPerLine; ++chunk) {
+            if (!ChunkHoldsSamples(mLines[p], chunk)) continue;
+            TremoloStateChunk record = {p, (int32_t) chunk};
+            memcpy(out, &record, sizeof (record));
+            out += sizeof (record);
+            memcpy(out, mLines[p].last + (chunk << kClearChunkShift) * mLanes, sampleBytes);
+            out += sampleBytes;
+            memcpy(out, mLines[p].line + (chunk << kClearChunkShift) * mLanes, sampleBytes);
+            out += sampleBytes;
+            ++header.chunkCount;
+        }
+    }
+    memcpy(outData, &header, sizeof (header));
+    return size;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	TremoloCore::AcceptsState
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Checks everything RestoreState relies on: the layout of the lines, a head inside each
+//  line and each chunk inside the lines, so a damaged snapshot can't write out of bounds.
+//  The rates must also be whole multiples of the decimation, as UpdateDelayLengths makes
+//  them, since the decimated loop keeps rate >> shift samples of each line.
+bool TremoloCore::AcceptsState (const void *inData, size_t inSize) const {
+    if (inData == NULL || inSize < sizeof (TremoloStateHeader)) return false;
+    
+    TremoloStateHeader header;
+    memcpy(&header, inData, sizeof (header));
+    long chunksPerLine = (long) (mChunkStamps.size () / kDelayPaths);
+    if (header.magic != kTremoloStateMagic || header.version != kTremoloStateVersion
+        || header.storage != TREMOLO_LINE_STORAGE || header.lanes != mLanes
+        || header.decimationShift != mDecimationShift || header.capacity != mDelayCapacity
+        || header.chunksPerLine != chunksPerLine || header.chunkCount < 0) return false;
+    
+    size_t sampleBytes = sizeof (TremoloLineSample) * kClearChunkSamples * mLanes;
+    size_t chunkBytes = sizeof (TremoloStateChunk) + 2 * sampleBytes;
+    if ((inSize - sizeof (header)) / chunkBytes != (size_t) header.chunkCount
+        || (inSize - sizeof (header)) % chunkBytes != 0) return false;
+    
+    for (int p = 0; p < kDelayPaths; ++p) {
+        if (mDelayCapacity > 0 && (header.rates[p] < 1 || header.rates[p] > mDelayCapacity)) return false;
+        if (header.rates[p] & ((1 << mDecimationShift) - 1)) return false;
+        if (header.heads[p] < 0 || header.heads[p] >= header.rates[p]) return false;
+        if (header.directions[p] != 1 && header.directions[p] != -1) return false;
+    }
+    
+    const unsigned char *in = (const unsigned char *) inData + sizeof (header);
+    for (int32_t k = 0; k < header.chunkCount; ++k, in += chunkBytes) {
+        TremoloStateChunk record;
+        memcpy(&record, in, sizeof (record));
+        if (record.path < 0 || record.path >= kDelayPaths || record.chunk < 0 || record.chunk >= chunksPerLine) return false;
+    }
+    return true;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	TremoloCore::RestoreState
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Starting a new generation of each pair stands in for clearing it; the chunks in the
+//  snapshot are copied back and stamped current, and the rest read as zero once a head
+//  reaches them, as after Reset. A restore isn't counted among the line resets.
+bool TremoloCore::RestoreState (const void *inData, size_t inSize) {
+    if (!AcceptsState(inData, inSize)) return false;
+    
+    TremoloStateHeader header;
+    memcpy(&header, inData, sizeof (header));
+    for (int c = 0; c < kMaxLinkedLanes; ++c) {
+        last[c] = header.last[c];
+        mGroupInput[c] = header.groupInput[c];
+    }
+    for (int p = 0; p < kDelayPaths; ++p) {
+        mHeads[p] = header.heads[p];
+        mRates[p] = header.rates[p];
+        mDirections[p] = header.directions[p];
+        mLines[p].Discard();
+        for (int k = 0; k < 3; ++k) mLines[p].peaks[k] = header.peaks[p][k];
+        mEnvelopes[p].sinValue = header.envelopes[p][0];
+        mEnvelopes[p].cosValue = header.envelopes[p][1];
+        mEnvelopes[p].sinStep = header.envelopes[p][2];
+        mEnvelopes[p].cosStep = header.envelopes[p][3];
+    }
+    
+    size_t sampleBytes = sizeof (TremoloLineSample) * kClearChunkSamples * mLanes;
+    const unsigned char *in = (const unsigned char *) inData + sizeof (header);
+    for (int32_t k = 0; k < header.chunkCount; ++k) {
+        TremoloStateChunk record;
+        memcpy(&record, in, sizeof (record));
+        in += sizeof (record);
+        LazyDelayLinePair &lines = mLines[record.path];
+        memcpy(lines.last + ((long) record.chunk << kClearChunkShift) * mLanes, in, sampleBytes);
+        in += sampleBytes;
+        memcpy(lines.line + ((long) record.chunk << kClearChunkShift) * mLanes, in, sampleBytes);
+        in += sampleBytes;
+        lines.stamps[record.chunk] = lines.generation;
+    }
+    return true;
+}
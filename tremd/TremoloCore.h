@@ -0,0 +1,675 @@
+/*
+Copyright (C) 2016 Apple Inc. All Rights Reserved.
+See LICENSE.txt for this sample’s licensing information
+
+Abstract:
+Tremolo Effect DSP, shared by the AU and the offline tools
+*/
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "Denormals.h"
+
+#ifndef __TremoloCore_h__
+#define __TremoloCore_h__
+
+// Nothing in this file depends on the AU SDK or Core Foundation. TremoloUnit wraps it
+//  in an AUKernelBase, and tools/ builds it on its own to render files without a host.
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Constants for parameters
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// The parameter names the host sees are in TremoloUnit.h.
+#pragma mark ____TremoloCore Parameter Constants
+// 2
+static const int kDefaultValue_Length = 8;
+static const int kMinimumValue_Length = 1;
+static const int kMaximumValue_Length = 32;
+static const long maxDelaySamples = 512*512;
+static const double kMinimumBeatsPerSecond = 20.0/60;	// slowest host tempo the delay lines are sized for
+static const int kDelayPaths = 3;			// the main, ring and signal power delays of a kernel
+static const int kDelayLinesPerKernel = 2*kDelayPaths;
+static const long kDelayLineAlignment = 16; // in floats, one 64 byte cache line
+static const int kClearChunkShift = 6;
+static const long kClearChunkSamples = 1 << kClearChunkShift; // lines are cleared lazily in chunks of 64 samples
+static const int kMaxLinkedLanes = 8;		// most channels one kernel renders side by side
+static const int kMaximumDecimation = 4;	// most frames one stored sample of a decimated line stands for
+static const float kSilenceThreshold = 1.0e-6f;	// -120 dB, below which the input and the tail count as silent
+static const int kMaximumTailPasses = 1000;	// a feedback depth of 1 never dies away, so stop counting here
+// 6
+static const int kForward_Direction	= 1;
+static const int kBackward_Direction = 2;
+static const int kDefaultValue_Direction = kBackward_Direction;
+// 1
+static const float kDefaultValue_Mix = 0.5;
+static const float kMinimumValue_Mix = 0.0;
+static const float kMaximumValue_Mix = 1.0;
+// 3
+static const int kDefaultValue_Signature = 1;
+static const int kMinimumValue_Signature = 1;
+static const int kMaximumValue_Signature = 5;
+// 4
+static const int kDefaultValue_Speed = 1;
+static const int kMinimumValue_Speed = 1;
+static const int kMaximumValue_Speed = 4;
+// 5
+static const float kDefaultValue_Depth = 0.5;
+static const float kMinimumValue_Depth = 0.0;
+static const float kMaximumValue_Depth = 1.0;
+// 19
+static const int kDefaultValue_Delay_Power = 2;
+static const int kMinimumValue_Delay_Power = 1.0;
+static const int kMaximumValue_Delay_Power = 5.0;
+// 20
+static const float kDefaultValue_Delay_Power_Scale = 2.5;
+static const float kMinimumValue_Delay_Power_Scale = 0.0;
+static const float kMaximumValue_Delay_Power_Scale = 5.0;
+// 12
+static const int kForward_Ring_Direction = 1;
+static const int kBackward_Ring_Direction = 2;
+static const int kDefaultValue_Ring_Direction= kForward_Ring_Direction;
+// 7
+static const float kDefaultValue_Ring_Mix = 0.3;
+static const float kMinimumValue_Ring_Mix = 0.0;
+static const float kMaximumValue_Ring_Mix = 1.0;
+// 8
+static const float kDefaultValue_Ring = 0.3;
+static const float kMinimumValue_Ring = 0.0;
+static const float kMaximumValue_Ring = 4.0;
+// 9
+static const int kDefaultValue_Ring_Signature = 3;
+static const int kMinimumValue_Ring_Signature = 1;
+static const int kMaximumValue_Ring_Signature = 5;
+// 10
+static const int kDefaultValue_Ring_Speed = 2;
+static const int kMinimumValue_Ring_Speed = 1;
+static const int kMaximumValue_Ring_Speed = 4;
+// 11
+static const float kDefaultValue_Ring_Depth	= 0.7;
+static const float kMinimumValue_Ring_Depth	= 0.0;
+static const float kMaximumValue_Ring_Depth	= 1.0;
+// 18
+static const int kForward_Signal_Power_Direction = 1;
+static const int kBackward_Signal_Power_Direction = 2;
+static const int kDefaultValue_Signal_Power_Direction= kForward_Signal_Power_Direction;
+// 13
+static const float kDefaultValue_Signal_Power = 3.0;
+static const float kMinimumValue_Signal_Power = 1.0;
+static const float kMaximumValue_Signal_Power = 5.0;
+// 14
+static const float kDefaultValue_Signal_Power_Scale = 2.0;
+static const float kMinimumValue_Signal_Power_Scale = 0.0;
+static const float kMaximumValue_Signal_Power_Scale = 5.0;
+// 15
+static const int kDefaultValue_Signal_Power_Signature = 5;
+static const int kMinimumValue_Signal_Power_Signature = 1;
+static const int kMaximumValue_Signal_Power_Signature = 5;
+// 16
+static const int kDefaultValue_Signal_Power_Speed = 2;
+static const int kMinimumValue_Signal_Power_Speed = 1;
+static const int kMaximumValue_Signal_Power_Speed = 4;
+// 17
+static const float kDefaultValue_Signal_Power_Depth	= 0.6;
+static const float kMinimumValue_Signal_Power_Depth	= 0.0;
+static const float kMaximumValue_Signal_Power_Depth	= 1.0;
+// 21
+static const int kDefaultValue_Fade	= 5;
+static const int kMinimumValue_Fade	= 0;
+static const int kMaximumValue_Fade	= 10;
+// 22
+static const int kDefaultValue_Duck	= 3;
+static const int kMinimumValue_Duck	= 0;
+static const int kMaximumValue_Duck	= 10;
+
+enum {
+    kParameter_Length                   = 0,
+    kParameter_Direction                = 1,
+    kParameter_Mix                      = 2,
+    kParameter_Signature                = 3,
+    kParameter_Speed                    = 4,
+    kParameter_Depth                    = 5,
+    kParameter_Delay_Power              = 6,
+    kParameter_Delay_Power_Scale        = 7,
+    kParameter_Ring_Direction           = 8,
+    kParameter_Ring_Mix                 = 9,
+    kParameter_Ring                     = 10,
+    kParameter_Ring_Signature           = 11,
+    kParameter_Ring_Speed               = 12,
+    kParameter_Ring_Depth               = 13,
+    kParameter_Signal_Power_Direction   = 14,
+    kParameter_Signal_Power             = 15,
+    kParameter_Signal_Power_Scale       = 16,
+    kParameter_Signal_Power_Signature   = 17,
+    kParameter_Signal_Power_Speed       = 18,
+    kParameter_Signal_Power_Depth       = 19,
+    kParameter_Fade                     = 20,
+    kParameter_Duck                     = 21,
+	kNumberOfParameters = 22
+};
+
+// the kDelayPaths delay paths of a kernel, which index its per-path state
+enum {
+	kMainPath = 0,
+	kRingPath = 1,
+	kSignalPowerPath = 2
+};
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Delay line storage
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// TREMOLO_LINE_STORAGE picks the format the delay lines keep their samples in:
+//
+//	0	float, the default
+//	1	IEEE half: 11 significant bits, rounded to nearest
+//	2	bfloat16: float's range with 8 significant bits, rounded to nearest
+//	3	int16 scaled to +/-kLineSampleFullScale, saturating: a fixed step of 1/8192
+//		however quiet the signal
+//
+// The 16 bit formats halve the memory the lines take and the bytes every sample moves.
+//  The arithmetic is unchanged and still done in float: samples are converted as they
+//  are loaded and rounded as they are stored, and nothing else in the kernel changes.
+//  Half uses the F16C instructions when the compiler targets them (-mf16c) and the
+//  native __fp16 type on ARM, and converts in software otherwise.
+//
+// On tremolo-bench's noise at the default settings the output moves from float's by
+//  about -100 dBFS for half, -85 for bfloat16 and -80 for int16. One channel renders no
+//  faster, as the conversions cost about what the smaller loads save; eight linked
+//  channels in half with F16C take about 0.6 of the float time.
+#ifndef TREMOLO_LINE_STORAGE
+#define TREMOLO_LINE_STORAGE 0
+#endif
+
+#if TREMOLO_LINE_STORAGE == 1 && defined (__F16C__)
+#include <immintrin.h>
+#endif
+
+#pragma mark ____Delay Line Storage
+#if TREMOLO_LINE_STORAGE == 0
+typedef float TremoloLineSample;
+static const char kLineStorageName[] = "float32";
+#elif TREMOLO_LINE_STORAGE == 1
+typedef uint16_t TremoloLineSample;
+static const char kLineStorageName[] = "float16";
+#elif TREMOLO_LINE_STORAGE == 2
+typedef uint16_t TremoloLineSample;
+static const char kLineStorageName[] = "bfloat16";
+#elif TREMOLO_LINE_STORAGE == 3
+typedef int16_t TremoloLineSample;
+static const char kLineStorageName[] = "int16";
+static const float kLineSampleFullScale = 4;	// the feedback can take a line past 1.0
+#else
+#error "TREMOLO_LINE_STORAGE must be 0, 1, 2 or 3"
+#endif
+
+inline uint32_t FloatBits (float inValue) {uint32_t bits; memcpy (&bits, &inValue, sizeof bits); return bits;}
+inline float BitsFloat (uint32_t inBits) {float value; memcpy (&value, &inBits, sizeof value); return value;}
+
+// the float a stored sample stands for
+inline float LoadLineSample (TremoloLineSample inSample) {
+#if TREMOLO_LINE_STORAGE == 0
+	return inSample;
+#elif TREMOLO_LINE_STORAGE == 1 && defined (__F16C__)
+	return _cvtsh_ss (inSample);
+#elif TREMOLO_LINE_STORAGE == 1 && defined (__aarch64__)
+	__fp16 half;
+	memcpy (&half, &inSample, sizeof half);
+	return half;
+#elif TREMOLO_LINE_STORAGE == 1
+	// moves the exponent and mantissa into place and rebiases the exponent; subnormal
+	//  halves come out of a float subtraction, and the formats never overflow this way
+	uint32_t bits = (uint32_t) (inSample & 0x7FFF) << 13;
+	uint32_t exponent = bits & (0x7C00 << 13);
+	bits += (127 - 15) << 23;
+	if (exponent == (0x7C00 << 13)) bits += (128 - 16) << 23;
+	else if (exponent == 0) bits = FloatBits (BitsFloat (bits + (1 << 23)) - BitsFloat (113 << 23));
+	return BitsFloat (bits | (uint32_t) (inSample & 0x8000) << 16);
+#elif TREMOLO_LINE_STORAGE == 2
+	return BitsFloat ((uint32_t) inSample << 16);
+#else
+	return inSample * (kLineSampleFullScale / 32767);
+#endif
+}
+
+// inValue rounded to the storage format
+inline TremoloLineSample StoreLineSample (float inValue) {
+#if TREMOLO_LINE_STORAGE == 0
+	return inValue;
+#elif TREMOLO_LINE_STORAGE == 1 && defined (__F16C__)
+	// saturate rather than round to infinity, which the feedback would never get rid of
+	if (inValue > 65504.0f) inValue = 65504.0f;
+	else if (inValue < -65504.0f) inValue = -65504.0f;
+	return _cvtss_sh (inValue, _MM_FROUND_TO_NEAREST_INT);
+#elif TREMOLO_LINE_STORAGE == 1 && defined (__aarch64__)
+	if (inValue > 65504.0f) inValue = 65504.0f;
+	else if (inValue < -65504.0f) inValue = -65504.0f;
+	__fp16 half = inValue;
+	TremoloLineSample sample;
+	memcpy (&sample, &half, sizeof sample);
+	return sample;
+#elif TREMOLO_LINE_STORAGE == 1
+	// rounds to nearest even: small values by letting a float addition shift the mantissa
+	//  into place, the rest by adding half a unit of the last place kept
+	uint32_t bits = FloatBits (inValue);
+	uint32_t sign = bits & 0x80000000u;
+	bits ^= sign;
+	uint16_t half;
+	if (bits >= ((127 + 16) << 23)) half = 0x7BFF;
+	else if (bits < (113 << 23)) {
+		const uint32_t denormalMagic = ((127 - 15) + (23 - 10) + 1) << 23;
+		half = (uint16_t) (FloatBits (BitsFloat (bits) + BitsFloat (denormalMagic)) - denormalMagic);
+	}
+	else {
+		uint32_t mantissaOdd = (bits >> 13) & 1;
+		bits += ((uint32_t) (15 - 127) << 23) + 0xFFF + mantissaOdd;
+		half = (bits < (0x7C00u << 13)) ? (uint16_t) (bits >> 13) : 0x7BFF;
+	}
+	return (TremoloLineSample) (half | sign >> 16);
+#elif TREMOLO_LINE_STORAGE == 2
+	// rounds to nearest even; the lines never hold NaN
+	uint32_t bits = FloatBits (inValue);
+	return (TremoloLineSample) ((bits + 0x7FFF + ((bits >> 16) & 1)) >> 16);
+#else
+	// truncates toward zero and shaves a little off as well, so a tail that has decayed
+	//  to a few steps still comes down to 0 rather than holding its last value forever
+	float scaled = inValue * (32767 / kLineSampleFullScale) * (1 - 1.0f/4096);
+	if (scaled > 32767) scaled = 32767;
+	else if (scaled < -32767) scaled = -32767;
+	return (TremoloLineSample) scaled;
+#endif
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// LazyDelayLinePair
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// The smoothed line and the feedback line of one delay path, which are always cleared
+//  together. Clear() is O(1): it starts a new generation, and each kClearChunkSamples chunk
+//  is zeroed the first time it is touched afterwards, so a tempo or length change never
+//  costs a full memset on the render thread. Process touches whole runs up front, which
+//  keeps the checks out of the per-sample loop.
+//
+// Indices count samples of the line; each one holds width samples, one per linked channel.
+//
+// The pair also keeps the largest magnitude stored into it during the pass of its head
+//  that is under way and the two passes before it. Every index is written once a pass, and
+//  the smoothing only averages what is already there, so nothing the lines hold can be
+//  larger; once the input stops, this is what tells TremoloCore the tail has died away.
+#pragma mark ____LazyDelayLinePair
+struct LazyDelayLinePair {
+	TremoloLineSample	*last = NULL;
+	TremoloLineSample	*line = NULL;
+	uint32_t			*stamps = NULL;		// generation each chunk was last zeroed in
+	uint32_t			generation = 0;
+	long				width = 1;
+	float				peaks[3] = {};		// the pass under way, then the two before it
+	uint64_t			resets = 0;			// Clear calls, for RenderMeter
+	uint64_t			chunkClears = 0;	// chunks zeroed
+
+	// empties both lines without counting a reset, for a snapshot that fills them again
+	void Discard () {
+		++generation;
+		peaks[0] = peaks[1] = peaks[2] = 0;
+	}
+
+	void Clear () {
+		Discard ();
+		++resets;
+	}
+
+	void NotePeak (float inPeak) {if (inPeak > peaks[0]) peaks[0] = inPeak;}
+
+	// the head wrapped, so every index has been written since the last call
+	void EndPass () {
+		peaks[2] = peaks[1];
+		peaks[1] = peaks[0];
+		peaks[0] = 0;
+	}
+
+	// bounds the magnitude of every sample either line holds
+	float Residual () const {
+		float residual = (peaks[0] > peaks[1]) ? peaks[0] : peaks[1];
+		return (peaks[2] > residual) ? peaks[2] : residual;
+	}
+
+	// touches indices inFirst through inLast, which must not wrap
+	void TouchSpan (long inFirst, long inLast) {
+		for (long chunk = inFirst >> kClearChunkShift; chunk <= (inLast >> kClearChunkShift); ++chunk) {
+			if (stamps[chunk] != generation) {
+				memset (last + (chunk << kClearChunkShift) * width, 0, sizeof (TremoloLineSample) * kClearChunkSamples * width);
+				memset (line + (chunk << kClearChunkShift) * width, 0, sizeof (TremoloLineSample) * kClearChunkSamples * width);
+				stamps[chunk] = generation;
+				++chunkClears;
+			}
+		}
+	}
+
+	// touches inCount indices from inStart on a line of inRate samples, together with the
+	//  neighbour on either side, wrapping around the end of the line
+	void TouchRun (long inStart, long inCount, long inRate) {
+		if (inCount + 2 >= inRate) {
+			TouchSpan (0, inRate - 1);
+			return;
+		}
+		long first = inStart - 1;
+		long final = inStart + inCount;
+		if (first < 0) first += inRate;
+		if (final >= inRate) final -= inRate;
+		if (first <= final) {
+			TouchSpan (first, final);
+		} else {
+			TouchSpan (first, inRate - 1);
+			TouchSpan (0, final);
+		}
+	}
+
+	// touches what a run of inCount samples writes when its head starts at inHead: the
+	//  head one ahead of each read, or its reflection when running backward
+	void TouchWrites (long inHead, long inCount, long inRate, int inDirection) {
+		if (inDirection > 0) TouchRun (inHead + 1, inCount, inRate);
+		else TouchRun (inRate - inHead - inCount, inCount, inRate);
+	}
+};
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// HeadEnvelope
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// sin(pi*head/rate) for a head that steps through its line one sample at a time. The value
+//  comes from rotating a phasor, so the render loop makes no transcendental calls; Start()
+//  is only needed when the rate changes or the head jumps. The state is kept in double so
+//  the drift over a full-capacity line stays far below float resolution, and every wrap
+//  to head 0 restarts the phasor exactly.
+#pragma mark ____HeadEnvelope
+struct HeadEnvelope {
+	double	sinValue = 0;
+	double	cosValue = 1;
+	double	sinStep = 0;
+	double	cosStep = 1;
+
+	void Start (long inHead, long inRate) {
+		double w = M_PI / inRate;
+		sinStep = sin (w);
+		cosStep = cos (w);
+		sinValue = sin (w * inHead);
+		cosValue = cos (w * inHead);
+	}
+
+	void Restart () {sinValue = 0; cosValue = 1;}
+
+	void Advance () {
+		double s = sinValue*cosStep + cosValue*sinStep;
+		cosValue = cosValue*cosStep - sinValue*sinStep;
+		sinValue = s;
+	}
+
+	float Value () const {return (float) sinValue;}
+};
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Delay line indexing
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Index arithmetic on a line of inRate samples for indices in [0, inRate]; each is a
+//  compare and select rather than an integer divide.
+inline int PrevIndex (int i, int inRate) {return i == 0 ? inRate - 1 : i - 1;}
+inline int NextIndex (int i, int inRate) {return i + 1 == inRate ? 0 : i + 1;}
+inline int WrapIndex (int i, int inRate) {return i == inRate ? 0 : i;}
+// (inRate - i) % inRate, the position a backward running head reads from
+inline int ReverseIndex (int i, int inRate) {return i == 0 ? 0 : inRate - i;}
+// WrapIndex(i) for a head running forward and ReverseIndex(i) for one running backward,
+//  for i in [1, inRate], with the direction as data rather than a branch: inDirection is
+//  1 or -1, and inOrigin is 0 forward and inRate backward
+inline int DirectedIndex (int i, int inOrigin, int inDirection, int inRate) {return WrapIndex (inOrigin + inDirection*i, inRate);}
+// NextIndex(i) when inStep is 1 and PrevIndex(i) when it is -1
+inline int StepIndex (int i, int inStep, int inRate) {int j = i + inStep; return (j < 0) ? inRate - 1 : WrapIndex (j, inRate);}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// IntPow
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// x raised to a compile-time integer exponent by repeated multiplication, standing in for
+//  pow() where the exponent parameters are known to be whole numbers.
+template <int N> inline float IntPow (float x) {return x * IntPow<N - 1> (x);}
+template <> inline float IntPow<0> (float) {return 1;}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// TremoloParameters
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// The parameter values for one render cycle. TremoloUnit reads, clamps and converts them
+//  once, works out the values that follow from them, and every kernel reads the same copy,
+//  so a kernel's per-buffer setup no longer depends on how many parameters there are.
+#pragma mark ____TremoloParameters
+struct TremoloParameters {
+	int		length = kDefaultValue_Length;
+	int		direction = -1;					// 1 forward, -1 backward
+	float	mix = kDefaultValue_Mix;
+	int		signature = kDefaultValue_Signature;
+	int		speed = kDefaultValue_Speed;
+	float	depth = kDefaultValue_Depth;
+	int		delayPower = kDefaultValue_Delay_Power;
+	float	delayPowerScale = kDefaultValue_Delay_Power_Scale;
+
+	int		ringDirection = 1;
+	float	ringMix = kDefaultValue_Ring_Mix;
+	float	ring = kDefaultValue_Ring;
+	int		ringSignature = kDefaultValue_Ring_Signature;
+	int		ringSpeed = kDefaultValue_Ring_Speed;
+	float	ringDepth = kDefaultValue_Ring_Depth;
+
+	int		signalPowerDirection = 1;
+	int		signalPower = kDefaultValue_Signal_Power;
+	float	signalPowerScale = kDefaultValue_Signal_Power_Scale;
+	int		signalPowerSignature = kDefaultValue_Signal_Power_Signature;
+	int		signalPowerSpeed = kDefaultValue_Signal_Power_Speed;
+	float	signalPowerDepth = kDefaultValue_Signal_Power_Depth;
+
+	int		fade = kDefaultValue_Fade;
+	int		duck = kDefaultValue_Duck;
+
+	// derived values
+	int		samplesPerDelay = 1;			// line lengths, within the arena's capacity
+	int		samplesPerRingDelay = 1;
+	int		samplesPerSignalPowerDelay = 1;
+	float	duckScale = 0;					// the ducked envelope is duckScale*envelope + duckFloor
+	float	duckFloor = 1;
+
+	// per-frame change of each parameter, indexed by parameter ID; nonzero only for a
+	//  continuous parameter that is ramping through the current slice
+	float	rampStep[kNumberOfParameters] = {};
+
+	// Stores one parameter, clamped to its range and converted the way the kernels use
+	//  it. The continuous parameters can also ramp, by inStep per frame over the next
+	//  inFrames frames; the discrete ones take the ramp's starting value.
+	void Apply (int inID, float inValue, float inStep, uint32_t inFrames);
+
+	// true when a parameter the delay lengths depend on differs from inOther
+	bool DelayLengthsDiffer (const TremoloParameters &inOther) const;
+
+	// Each line lasts length beats of its signature and speed at the tempo, and has to fit
+	//  inside lines of inCapacity frames. Decimated lines store one sample every
+	//  inDecimation frames, so their lengths are rounded down to a multiple of it.
+	void UpdateDelayLengths (double inSampleRate, double inBeatsPerSecond, long inCapacity, int inDecimation);
+
+	void UpdateDuck () {
+		duckScale = (float) duck/(duck + 1);
+		duckFloor = 1.0f/(duck + 1);
+	}
+
+	// How long the lines take to die away below kSilenceThreshold once the input stops,
+	//  in seconds: each pass scales a line by its depth, or by the smoothing's 2/3 when
+	//  that is smaller, and the longest line at the lowest decay decides.
+	double TailSeconds (double inSampleRate) const;
+};
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// TremoloDelayArena
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// One allocation backing the delay lines of every kernel. Each line holds the longest
+//  tempo-synced delay the parameters allow (length at its maximum, signature and speed at
+//  their minimum) at kMinimumBeatsPerSecond, capped at maxDelaySamples. It is sized for
+//  the slowest tempo rather than the host's, so a tempo change never outgrows it.
+//
+// The memory comes from calloc rather than being cleared by hand, so its pages stay
+//  untouched until a kernel actually reaches them; the resident size follows the delay
+//  lengths in use rather than the capacity.
+//
+// The lines can also be stored decimated, one sample for every 2 or 4 frames, which
+//  cuts memory and cache traffic by the same factor and lets maxDelaySamples reach 2 or 4
+//  times further. What goes into them is averaged over the frames each sample stands
+//  for, so it only suits rates well above what the top of the spectrum needs: at 192 kHz
+//  and a factor of 2 the delayed signal stays within about -50 dB of the full rate one
+//  at 1 kHz and -30 dB at 5 kHz, a factor of 4 loses 15 dB or more on that.
+#pragma mark ____TremoloDelayArena
+struct TremoloDelayArena {
+	void				*memory = NULL;
+	TremoloLineSample	*storage = NULL;	// memory, aligned to kDelayLineAlignment floats
+	long				capacity = 0;		// frames per delay line
+	long				stride = 0;			// samples stored for them, padded out to a whole number of clear chunks
+	int					decimation = 1;		// frames per stored sample
+
+	// a multiple of inDecimation, at most maxDelaySamples stored samples
+	static long CapacityFor (double inSampleRate, int inDecimation);
+
+	// the decimation that keeps the stored rate at 96 kHz or below
+	static int DecimationFor (double inSampleRate);
+
+	// room for inLineSets kernels of inLanes lanes each, holding inCapacity frames
+	//  decimated by inDecimation (1, 2 or 4); false when out of memory
+	bool Allocate (long inCapacity, size_t inLineSets, int inLanes, int inDecimation);
+	void Free ();
+
+	// the kDelayLinesPerKernel lines of the inIndex'th kernel
+	TremoloLineSample *LineSet (size_t inIndex, int inLanes) const {
+		return storage + inIndex * inLanes * kDelayLinesPerKernel * stride;
+	}
+};
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// TremoloCore
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// The state and render loop of one kernel: three delay paths and their heads, run over
+//  one channel or over up to kMaxLinkedLanes linked channels at once.
+#pragma mark ____TremoloCore
+class TremoloCore {
+	public:
+		TremoloCore (const TremoloParameters *inParameters);
+
+		void Reset ();
+
+		// the power of two lanes that hold inChannels linked channels
+		static int LanesFor (int inChannels);
+
+		// Hands the kernel its kDelayLinesPerKernel lines of inCapacity frames each,
+		//  carved out of a TremoloDelayArena, for inLanes channels side by side
+		//  (1, 2, 4 or 8) and decimated by inDecimation. inStride is a whole number of
+		//  clear chunks. A NULL inStorage leaves the kernel without lines, and
+		//  ProcessChannels does nothing.
+		void SetDelayStorage (TremoloLineSample *inStorage, long inStride, long inCapacity, int inLanes, int inDecimation);
+
+		// Renders inChannels channels (at most the lanes given to SetDelayStorage) that
+		//  share one set of heads and envelopes. Each pointer steps inStride floats a frame.
+		void ProcessChannels (
+			const float *const	*inSources,
+			float *const		*inDests,
+			int					inChannels,
+			int					inStride,
+			int					inFrames
+		);
+
+		// True when the input stays below kSilenceThreshold for all inFrames frames and
+		//  what is left in the lines can no longer bring the output up to it, so
+		//  SkipFrames can stand in for ProcessChannels and the output counts as silence.
+		//  Costs nothing while the lines still ring, and a pass over the input after.
+		bool IsSilent (
+			const float *const	*inSources,
+			int					inChannels,
+			int					inStride,
+			int					inFrames
+		) const;
+
+		// Moves the heads and envelopes on by inFrames frames without rendering them, as
+		//  though they had been silent, and empties the lines.
+		void SkipFrames (int inFrames);
+
+		// adds how many times the lines were emptied, and how many chunks of them zeroed
+		void AddLineCounts (uint64_t &ioResets, uint64_t &ioChunkClears) const {
+			for (int p = 0; p < kDelayPaths; ++p) {
+				ioResets += mLines[p].resets;
+				ioChunkClears += mLines[p].chunkClears;
+			}
+		}
+
+		// A snapshot of everything the kernel has rendered into: the heads, the lengths
+		//  and directions they latched, the envelopes, the peaks and the contents of the
+		//  lines. Chunks that are still waiting to be cleared, or hold only zeros, are
+		//  left out. The layout is native to the machine and to the build: it only
+		//  restores into a kernel with the same storage format, lanes, decimation and
+		//  capacity. Neither call may overlap ProcessChannels.
+		//
+		// StateSize is the size SaveState writes, and SaveState returns 0 without
+		//  writing anything when inCapacity is smaller than that.
+		size_t StateSize () const;
+		size_t SaveState (void *outData, size_t inCapacity) const;
+
+		// True when inData is a snapshot RestoreState can take up.
+		bool AcceptsState (const void *inData, size_t inSize) const;
+
+		// Copies a snapshot back into the lines this kernel already has, so it allocates
+		//  nothing, and leaves the chunks the snapshot skips to be cleared lazily. Anything
+		//  AcceptsState turns down leaves the kernel untouched and returns false.
+		bool RestoreState (const void *inData, size_t inSize);
+
+	private:
+		template <int DelayPower, int SignalPower, int Lanes>
+		void ProcessFrames (
+			const float *const		*inSources,
+			float *const			*inDests,
+			int						inChannels,
+			int						inStride,
+			int						inFrames,
+			const TremoloParameters &inParameters
+		);
+
+		// takes up the delay lengths and directions of inParameters, which only happens
+		//  while the main head is at 0
+		void FollowParameters (const TremoloParameters &inParameters);
+
+		// ProcessFrames for decimated lines
+		template <int DelayPower, int SignalPower, int Lanes>
+		void ProcessDecimatedFrames (
+			const float *const		*inSources,
+			float *const			*inDests,
+			int						inChannels,
+			int						inStride,
+			int						inFrames,
+			const TremoloParameters &inParameters
+		);
+
+		typedef void (TremoloCore::*FrameProcessor) (const float *const *, float *const *, int, int, int, const TremoloParameters &);
+		static FrameProcessor SelectFrameProcessor (int inDelayPower, int inSignalPower, int inLanes, bool inDecimated);
+
+		const TremoloParameters *mParameters;  // owned by the caller, read once per buffer
+
+		float last[kMaxLinkedLanes] = {};
+
+		// delay lines live in a TremoloDelayArena, see TremoloUnit::Initialize
+		long mDelayCapacity = 0;
+		int mLanes = 1;
+		int mDecimationShift = 0;		// log2 of the frames per stored sample
+		
+		// the input of the frames since the last stored sample of a decimated line
+		float mGroupInput[kMaxLinkedLanes] = {};
+		std::vector<uint32_t> mChunkStamps;
+
+		// The delay paths, indexed by kMainPath, kRingPath and kSignalPowerPath: each
+		//  has a head, the pair of lines it reads and writes and the fade envelope that
+		//  follows it. The lengths and directions in effect follow the parameters only
+		//  when the main head wraps.
+		int					mHeads[kDelayPaths] = {};
+		int					mRates[kDelayPaths] = {4096*4, 2048*3, 1024*5};
+		int					mDirections[kDelayPaths] = {1, 1, 1};
+		LazyDelayLinePair	mLines[kDelayPaths];
+		HeadEnvelope		mEnvelopes[kDelayPaths];
+};
+
+#endif
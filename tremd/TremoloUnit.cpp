@@ -70,6 +70,302 @@ TremoloUnit::TremoloUnit (AudioUnit component) : AUEffectBase (component) {
 	#endif
 }
 
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	TremoloUnit::Initialize
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Builds one kernel per channel (in AUEffectBase::Initialize), then allocates the delay
+//  lines for all of them at once from a TremoloDelayArena sized for the current sample
+//  rate and the slowest tempo, so the host can slow down later without the lines
+//  cutting the delays short.
+//
+// A Float32 stream of 2 to kMaxLinkedLanes channels is linked: the first kernel renders
+//  every channel, with each line holding the channels side by side in a power of two
+//  lanes, and the other kernels are left without lines.
+ComponentResult TremoloUnit::Initialize () {
+	ComponentResult result = AUEffectBase::Initialize ();
+	if (result != noErr) return result;
+	
+	mDelayArena.Free ();
+	
+	Float64 bpm;
+	if (CallHostBeatAndTempo (NULL, &bpm) == noErr && bpm > 0) mBeatsPerSecond = bpm/60;
+	
+	size_t nKernels = mKernelList.size ();
+	
+	mLinkedChannels = 0;
+#if TREMOLO_LINKED_CHANNELS
+	if (nKernels >= 2 && nKernels <= kMaxLinkedLanes && mKernelList[0] != NULL
+		&& GetCommonPCMFormat () == CAStreamBasicDescription::kPCMFormatFloat32)
+		mLinkedChannels = (int) nKernels;
+#endif
+	int lanes = TremoloCore::LanesFor (mLinkedChannels);
+	
+	int decimation = 1;
+#if TREMOLO_DECIMATED_LINES
+	decimation = TremoloDelayArena::DecimationFor (GetSampleRate ());
+#endif
+	long capacity = TremoloDelayArena::CapacityFor (GetSampleRate (), decimation);
+	size_t lineSets = (mLinkedChannels > 0) ? 1 : nKernels;
+	if (!mDelayArena.Allocate (capacity, lineSets, lanes, decimation)) return kAudio_MemFullError;
+	mDelayLengthsChanged = true;
+	
+	mRenderMeter.Reset ();
+	for (size_t i = 0; i < nKernels; ++i) {
+		TremoloUnitKernel *kernel = static_cast<TremoloUnitKernel *> (mKernelList[i]);
+		if (kernel == NULL) continue;
+		kernel->SetMeter (&mRenderMeter, (int) i);
+		if (mLinkedChannels == 0)
+			kernel->Core ().SetDelayStorage (mDelayArena.LineSet (i, 1), mDelayArena.stride, capacity, 1, decimation);
+		else if (i == 0)
+			kernel->Core ().SetDelayStorage (mDelayArena.LineSet (0, lanes), mDelayArena.stride, capacity, lanes, decimation);
+		else
+			kernel->Core ().SetDelayStorage (NULL, 0, 0, 1, 1);
+	}
+	
+	return noErr;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	TremoloUnit::Cleanup
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// The kernels point into the arena, so they go first.
+void TremoloUnit::Cleanup () {
+	AUEffectBase::Cleanup ();
+	mDelayArena.Free ();
+}
+
+#pragma mark ____Rendering
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	TremoloUnit::Render
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Asks the host for its tempo once per render cycle, however many channels and slices
+//  follow, and flags the delay lengths for recalculation only when it actually moved. If
+//  the host can't say, the last tempo it gave stays in effect.
+//
+// Parameters with events scheduled in this cycle are left out of the refresh; they hold
+//  their previous value until their first event, and ProcessScheduledSlice moves them on
+//  from there. Afterwards each is set to the value its events reach at the end of the
+//  buffer, so a finished ramp doesn't fall back to its start value in the next cycle.
+//
+// The kernels run with flush-to-zero on, see Denormals.h. mRenderMeter times the whole
+//  call, parameter handling included, since that is what the host waits for.
+OSStatus TremoloUnit::Render (
+	AudioUnitRenderActionFlags	&ioActionFlags,
+	const AudioTimeStamp		&inTimeStamp,
+	UInt32						inFramesToProcess
+) {
+	uint64_t renderStart = RenderMeter::Now ();
+	
+	Float64 bpm;
+	if (CallHostBeatAndTempo (NULL, &bpm) == noErr && bpm > 0 && bpm/60 != mBeatsPerSecond) {
+		mBeatsPerSecond = bpm/60;
+		mDelayLengthsChanged = true;
+	}
+	
+	mScheduledParameters = 0;
+	for (ParameterEventList::const_iterator it = mParamList.begin (); it != mParamList.end (); ++it) {
+		if (it->scope == kAudioUnitScope_Global && it->parameter < kNumberOfParameters) {
+			mScheduledParameters |= 1u << it->parameter;
+			mParameters.rampStep[it->parameter] = 0;
+		}
+	}
+	
+	UpdateParameters ();
+	
+	OSStatus result;
+	{
+		DenormalGuard denormalGuard;
+		result = AUEffectBase::Render (ioActionFlags, inTimeStamp, inFramesToProcess);
+	}
+	
+	if (mScheduledParameters != 0) {
+		AudioUnitParameterValue values[kNumberOfParameters], steps[kNumberOfParameters];
+		UInt32 found = GetScheduledValues (inFramesToProcess, values, steps);
+		for (AudioUnitParameterID id = 0; id < kNumberOfParameters; ++id) {
+			if (found & (1u << id)) Globals () -> SetParameter (id, values[id]);
+		}
+	}
+	
+	uint64_t lineResets = 0, lineClears = 0;
+	for (size_t i = 0; i < mKernelList.size (); ++i) {
+		TremoloCore *core = KernelCore (i);
+		if (core != NULL) core->AddLineCounts (lineResets, lineClears);
+	}
+	mRenderMeter.SetLineCounts (lineResets, lineClears);
+	mRenderMeter.AddRender (renderStart, RenderMeter::Now (), inFramesToProcess, GetSampleRate ());
+	return result;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	TremoloUnit::ProcessScheduledSlice
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// AUBase cuts the buffer at every event offset and ramp end, so within one slice each
+//  parameter is either constant or on a single straight ramp. Only the parameters with
+//  events are brought up to date here; a ramp is handed to the kernels as a start value
+//  and a per-frame step.
+//
+// Every slice shares the buffer's action flags, reading the input's silence flag from them
+//  and writing its own output's back. Each slice is handed the input's flag as the first
+//  one found it, and the flag left after it says whether all the slices so far were
+//  silent, so a silent slice after one that rendered can't get the whole buffer zeroed.
+//  A skipped slice writes its zeros itself.
+OSStatus TremoloUnit::ProcessScheduledSlice (
+	void	*inUserData,
+	UInt32	inStartFrameInBuffer,
+	UInt32	inSliceFramesToProcess,
+	UInt32	inTotalBufferFrames
+) {
+	AudioUnitParameterValue values[kNumberOfParameters], steps[kNumberOfParameters];
+	UInt32 found = GetScheduledValues (inStartFrameInBuffer, values, steps);
+	
+	if (found != 0) {
+		const TremoloParameters previous = mParameters;
+		for (AudioUnitParameterID id = 0; id < kNumberOfParameters; ++id) {
+			if (found & (1u << id)) mParameters.Apply (id, values[id], steps[id], inSliceFramesToProcess);
+		}
+		UpdateDerivedParameters (previous);
+	}
+	
+	AudioUnitRenderActionFlags &actionFlags = *static_cast<ScheduledProcessParams *> (inUserData)->actionFlags;
+	if (inStartFrameInBuffer == 0) {
+		mSliceInputSilent = (actionFlags & kAudioUnitRenderAction_OutputIsSilence) != 0;
+		mSlicesSounded = false;
+	}
+	if (mSliceInputSilent) actionFlags |= kAudioUnitRenderAction_OutputIsSilence;
+	else actionFlags &= ~kAudioUnitRenderAction_OutputIsSilence;
+	
+	OSStatus result = AUEffectBase::ProcessScheduledSlice (inUserData, inStartFrameInBuffer, inSliceFramesToProcess, inTotalBufferFrames);
+	
+	if ((actionFlags & kAudioUnitRenderAction_OutputIsSilence) == 0) mSlicesSounded = true;
+	if (mSlicesSounded) actionFlags &= ~kAudioUnitRenderAction_OutputIsSilence;
+	else actionFlags |= kAudioUnitRenderAction_OutputIsSilence;
+	return result;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	TremoloUnit::GetScheduledValues
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Works out from this cycle's events where each scheduled parameter is at inFrame, and
+//  how far it moves per frame from there. The latest event starting at or before inFrame
+//  decides; a ramp that has already ended leaves its end value. Returns a bit for each
+//  parameter that some event has reached by inFrame.
+UInt32 TremoloUnit::GetScheduledValues (
+	SInt32					inFrame,
+	AudioUnitParameterValue	*outValues,
+	AudioUnitParameterValue	*outSteps
+) {
+	UInt32 found = 0;
+	SInt32 latestStart[kNumberOfParameters];
+	
+	for (ParameterEventList::const_iterator it = mParamList.begin (); it != mParamList.end (); ++it) {
+		const AudioUnitParameterEvent &event = *it;
+		if (event.scope != kAudioUnitScope_Global || event.parameter >= kNumberOfParameters) continue;
+		
+		AudioUnitParameterID id = event.parameter;
+		SInt32 start = (event.eventType == kParameterEvent_Immediate)
+			? (SInt32) event.eventValues.immediate.bufferOffset
+			: event.eventValues.ramp.startBufferOffset;
+		if (start > inFrame) continue;
+		if ((found & (1u << id)) && start < latestStart[id]) continue;
+		
+		found |= 1u << id;
+		latestStart[id] = start;
+		outSteps[id] = 0;
+		
+		if (event.eventType == kParameterEvent_Immediate) {
+			outValues[id] = event.eventValues.immediate.value;
+		} else {
+			SInt32 elapsed = inFrame - start;
+			SInt32 duration = (SInt32) event.eventValues.ramp.durationInFrames;
+			if (elapsed >= duration) {
+				outValues[id] = event.eventValues.ramp.endValue;
+			} else {
+				outSteps[id] = (event.eventValues.ramp.endValue - event.eventValues.ramp.startValue) / duration;
+				outValues[id] = event.eventValues.ramp.startValue + outSteps[id] * elapsed;
+			}
+		}
+	}
+	return found;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	TremoloUnit::ProcessBufferLists
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Linked channels go to the first kernel in one call, with the silence handling of
+//  AUEffectBase::ProcessBufferListsT and of TremoloUnitKernel::Process, skipped frames
+//  written out as zeros; otherwise every kernel renders its own channel.
+OSStatus TremoloUnit::ProcessBufferLists (
+	AudioUnitRenderActionFlags	&ioActionFlags,
+	const AudioBufferList		&inBuffer,
+	AudioBufferList				&outBuffer,
+	UInt32						inFramesToProcess
+) {
+	if (mLinkedChannels == 0 || ShouldBypassEffect ())
+		return AUEffectBase::ProcessBufferLists (ioActionFlags, inBuffer, outBuffer, inFramesToProcess);
+	
+	bool silentInput = IsInputSilent (ioActionFlags, inFramesToProcess);
+	ioActionFlags |= kAudioUnitRenderAction_OutputIsSilence;
+	
+	const Float32 *sources[kMaxLinkedLanes];
+	Float32 *dests[kMaxLinkedLanes];
+	int stride;
+	if (inBuffer.mNumberBuffers == 1) {
+		stride = inBuffer.mBuffers[0].mNumberChannels;
+		for (int c = 0; c < mLinkedChannels; ++c) {
+			sources[c] = (const Float32 *) inBuffer.mBuffers[0].mData + c;
+			dests[c] = (Float32 *) outBuffer.mBuffers[0].mData + c;
+		}
+	} else {
+		stride = 1;
+		for (int c = 0; c < mLinkedChannels; ++c) {
+			sources[c] = (const Float32 *) inBuffer.mBuffers[c].mData;
+			dests[c] = (Float32 *) outBuffer.mBuffers[c].mData;
+		}
+	}
+	
+	uint64_t start = RenderMeter::Now ();
+	TremoloCore &core = static_cast<TremoloUnitKernel *> (mKernelList[0])->Core ();
+	if (silentInput || core.IsSilent (sources, mLinkedChannels, stride, inFramesToProcess)) {
+		core.SkipFrames (inFramesToProcess);
+		for (int c = 0; c < mLinkedChannels; ++c) {
+			for (UInt32 i = 0; i < inFramesToProcess; ++i) dests[c][i*stride] = 0;
+		}
+	} else {
+		core.ProcessChannels (sources, dests, mLinkedChannels, stride, inFramesToProcess);
+		ioActionFlags &= ~kAudioUnitRenderAction_OutputIsSilence;
+	}
+	mRenderMeter.AddKernel (0, RenderMeter::Now () - start);
+	return noErr;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	TremoloUnit::UpdateParameters
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Reads every parameter without scheduled events into mParameters, then works out the
+//  values that follow from them.
+void TremoloUnit::UpdateParameters () {
+	const TremoloParameters previous = mParameters;
+	
+	for (AudioUnitParameterID id = 0; id < kNumberOfParameters; ++id) {
+		if ((mScheduledParameters & (1u << id)) == 0) mParameters.Apply (id, GetParameter (id), 0, 0);
+	}
+	UpdateDerivedParameters (previous);
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	TremoloUnit::UpdateDerivedParameters
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// The delay lengths are only worked out again when the tempo, the capacity or one of the
+//  parameters they depend on has changed since inPrevious.
+void TremoloUnit::UpdateDerivedParameters (const TremoloParameters &inPrevious) {
+	if (mDelayLengthsChanged || mParameters.DelayLengthsDiffer (inPrevious)) {
+		mParameters.UpdateDelayLengths (GetSampleRate (), mBeatsPerSecond, mDelayArena.capacity, mDelayArena.decimation);
+		mDelayLengthsChanged = false;
+	}
+	mParameters.UpdateDuck ();
+}
+
 
 #pragma mark ____Parameters
 
@@ -368,14 +664,24 @@ ComponentResult TremoloUnit::GetParameterValueStrings (
 //	TremoloUnit::GetPropertyInfo
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 ComponentResult TremoloUnit::GetPropertyInfo (
-	// This audio unit doesn't define any custom properties, so it uses this generic code for
-	// this method.
 	AudioUnitPropertyID	inID,
 	AudioUnitScope		inScope,
 	AudioUnitElement	inElement,
 	UInt32				&outDataSize,
 	Boolean				&outWritable
 ) {
+	if (inID == kTremoloUnitProperty_KernelState) {
+		if (inScope != kAudioUnitScope_Global) return kAudioUnitErr_InvalidScope;
+		outDataSize = sizeof (CFDataRef);
+		outWritable = true;
+		return noErr;
+	}
+	if (inID == kTremoloUnitProperty_RenderMeter || inID == kTremoloUnitProperty_RenderMeterRing) {
+		if (inScope != kAudioUnitScope_Global) return kAudioUnitErr_InvalidScope;
+		outDataSize = (inID == kTremoloUnitProperty_RenderMeter) ? sizeof (RenderMeterStats) : sizeof (RenderMeterRing *);
+		outWritable = false;
+		return noErr;
+	}
 	return AUEffectBase::GetPropertyInfo (inID, inScope, inElement, outDataSize, outWritable);
 }
 
@@ -383,16 +689,134 @@ ComponentResult TremoloUnit::GetPropertyInfo (
 //	TremoloUnit::GetProperty
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 ComponentResult TremoloUnit::GetProperty (
-	// This audio unit doesn't define any custom properties, so it uses this generic code for
-	// this method.
 	AudioUnitPropertyID inID,
 	AudioUnitScope 		inScope,
 	AudioUnitElement 	inElement,
 	void				*outData
 ) {
+	if (inID == kTremoloUnitProperty_KernelState) {
+		if (inScope != kAudioUnitScope_Global) return kAudioUnitErr_InvalidScope;
+		if (!IsInitialized ()) return kAudioUnitErr_Uninitialized;
+		CFDataRef state = CopyKernelState ();
+		if (state == NULL) return kAudio_MemFullError;
+		*(CFDataRef *) outData = state;
+		return noErr;
+	}
+	if (inID == kTremoloUnitProperty_RenderMeter) {
+		if (inScope != kAudioUnitScope_Global) return kAudioUnitErr_InvalidScope;
+		mRenderMeter.Read (*(RenderMeterStats *) outData);
+		return noErr;
+	}
+	if (inID == kTremoloUnitProperty_RenderMeterRing) {
+		if (inScope != kAudioUnitScope_Global) return kAudioUnitErr_InvalidScope;
+		*(RenderMeterRing **) outData = mRenderMeter.StartStreaming ();
+		return noErr;
+	}
 	return AUEffectBase::GetProperty (inID, inScope, inElement, outData);
 }
 
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	TremoloUnit::SetProperty
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ComponentResult TremoloUnit::SetProperty (
+	AudioUnitPropertyID inID,
+	AudioUnitScope 		inScope,
+	AudioUnitElement 	inElement,
+	const void			*inData,
+	UInt32				inDataSize
+) {
+	if (inID == kTremoloUnitProperty_KernelState) {
+		if (inScope != kAudioUnitScope_Global) return kAudioUnitErr_InvalidScope;
+		if (!IsInitialized ()) return kAudioUnitErr_Uninitialized;
+		if (inDataSize != sizeof (CFDataRef) || inData == NULL) return kAudioUnitErr_InvalidPropertyValue;
+		return RestoreKernelState (*(const CFDataRef *) inData);
+	}
+	return AUEffectBase::SetProperty (inID, inScope, inElement, inData, inDataSize);
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	TremoloUnit::KernelCore
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+TremoloCore *TremoloUnit::KernelCore (size_t inIndex) const {
+	TremoloUnitKernel *kernel = static_cast<TremoloUnitKernel *> (mKernelList[inIndex]);
+	return (kernel != NULL) ? &kernel->Core () : NULL;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	TremoloUnit::CopyKernelState
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// The kernel count, then for each kernel the size of its TremoloCore snapshot and the
+//  snapshot; a missing kernel has a size of 0. Linked channels all live in the first
+//  kernel's lines, so the others only hold their header.
+CFDataRef TremoloUnit::CopyKernelState () const {
+	size_t nKernels = mKernelList.size ();
+	CFIndex total = sizeof (UInt32);
+	for (size_t i = 0; i < nKernels; ++i) {
+		TremoloCore *core = KernelCore (i);
+		total += sizeof (UInt32) + ((core != NULL) ? core->StateSize () : 0);
+	}
+	
+	CFMutableDataRef state = CFDataCreateMutable (NULL, total);
+	if (state == NULL) return NULL;
+	CFDataSetLength (state, total);
+	UInt8 *out = CFDataGetMutableBytePtr (state);
+	
+	UInt32 count = (UInt32) nKernels;
+	memcpy (out, &count, sizeof (count));
+	out += sizeof (count);
+	for (size_t i = 0; i < nKernels; ++i) {
+		TremoloCore *core = KernelCore (i);
+		UInt32 size = (core != NULL) ? (UInt32) core->StateSize () : 0;
+		memcpy (out, &size, sizeof (size));
+		out += sizeof (size);
+		if (core != NULL) out += core->SaveState (out, size);
+	}
+	return state;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	TremoloUnit::RestoreKernelState
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// The snapshot goes back into the lines Initialize already allocated, one memcpy a
+//  chunk, so it has to come from the same build, initialized with the same channels,
+//  sample rate and tempo. Every kernel checks its part before any takes it up, so a
+//  snapshot that doesn't fit leaves the unit as it was.
+OSStatus TremoloUnit::RestoreKernelState (CFDataRef inState) {
+	if (inState == NULL) return kAudioUnitErr_InvalidPropertyValue;
+	const UInt8 *bytes = CFDataGetBytePtr (inState);
+	size_t length = (size_t) CFDataGetLength (inState);
+	size_t nKernels = mKernelList.size ();
+	
+	UInt32 count;
+	if (length < sizeof (count)) return kAudioUnitErr_InvalidPropertyValue;
+	memcpy (&count, bytes, sizeof (count));
+	if (count != nKernels) return kAudioUnitErr_InvalidPropertyValue;
+	
+	size_t offset = sizeof (count);
+	for (size_t i = 0; i < nKernels; ++i) {
+		UInt32 size;
+		if (length - offset < sizeof (size)) return kAudioUnitErr_InvalidPropertyValue;
+		memcpy (&size, bytes + offset, sizeof (size));
+		offset += sizeof (size);
+		TremoloCore *core = KernelCore (i);
+		if (length - offset < size) return kAudioUnitErr_InvalidPropertyValue;
+		if ((core == NULL) ? (size != 0) : !core->AcceptsState (bytes + offset, size)) return kAudioUnitErr_InvalidPropertyValue;
+		offset += size;
+	}
+	if (offset != length) return kAudioUnitErr_InvalidPropertyValue;
+	
+	offset = sizeof (count);
+	for (size_t i = 0; i < nKernels; ++i) {
+		UInt32 size;
+		memcpy (&size, bytes + offset, sizeof (size));
+		offset += sizeof (size);
+		TremoloCore *core = KernelCore (i);
+		if (core != NULL) core->RestoreState (bytes + offset, size);
+		offset += size;
+	}
+	return noErr;
+}
+
 #pragma mark ____Factory Presets
 
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -511,28 +935,20 @@ OSStatus TremoloUnit::NewFactoryPresetSet (
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 //	TremoloUnit::TremoloUnitKernel::TremoloUnitKernel()
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-// This is the constructor for the TremoloUnitKernel helper class, which holds the DSP code 
-//  for the audio unit. TremoloUnit is an n-to-n audio unit; one kernel object gets built for 
-//  each channel in the audio unit.
+// This is the constructor for the TremoloUnitKernel helper class, which runs the DSP code 
+//  in TremoloCore for the audio unit. TremoloUnit is an n-to-n audio unit; one kernel object 
+//  gets built for each channel in the audio unit.
 //
 // The first line of the method consists of the constructor method declarator and constructor-
 //  initializer. In addition to calling the appropriate superclasses, this code initializes two 
 //  member variables:
 //
 // (In the Xcode template, the header file contains the call to the superclass constructor.)
-TremoloUnit::TremoloUnitKernel::TremoloUnitKernel (AUEffectBase *inAudioUnit ) : AUKernelBase (inAudioUnit),
-	mSamplesProcessed (0)//, mCurrentScale (0)
+TremoloUnit::TremoloUnitKernel::TremoloUnitKernel (AUEffectBase *inAudioUnit, const TremoloParameters *inParameters ) : AUKernelBase (inAudioUnit),
+	mSamplesProcessed (0),//, mCurrentScale (0)
+	mCore (inParameters)
 {	
 	mSampleFrequency = GetSampleRate ();
-    
-    memset(lastDelay,0,sizeof(float)*maxDelaySamples);
-    memset(delay,0,sizeof(float)*maxDelaySamples);
-
-    memset(lastRingDelay,0,sizeof(float)*maxDelaySamples);
-    memset(ringDelay,0,sizeof(float)*maxDelaySamples);
-    
-    memset(lastSignalPowerDelay,0,sizeof(float)*maxDelaySamples);
-    memset(signalPowerDelay,0,sizeof(float)*maxDelaySamples);
 }
 
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -541,279 +957,37 @@ TremoloUnit::TremoloUnitKernel::TremoloUnitKernel (AUEffectBase *inAudioUnit ) :
 void TremoloUnit::TremoloUnitKernel::Reset() {
 	mSamplesProcessed	= 0;
     
-    head = 0;
-    rhead = 0;
-    phead = 0;
-    
-//    first = true;
-//    firstRing = true;
-    
-    memset(lastDelay,0,sizeof(float)*maxDelaySamples);
-    memset(delay,0,sizeof(float)*maxDelaySamples);
-    
-    memset(lastRingDelay,0,sizeof(float)*maxDelaySamples);
-    memset(ringDelay,0,sizeof(float)*maxDelaySamples);
-    
-    memset(lastSignalPowerDelay,0,sizeof(float)*maxDelaySamples);
-    memset(signalPowerDelay,0,sizeof(float)*maxDelaySamples);
+    mCore.Reset();
 }
 
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 //	TremoloUnit::TremoloUnitKernel::Process
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-// This method contains the DSP code. 
+// Hands the channel to the DSP code in TremoloCore. 
+//
+// AUEffectBase only flags the input as silent once it has been silent for GetTailTime; until
+//  then the core decides for itself, and once the input is silent and nothing left in its
+//  lines can reach the output, the buffer is skipped and the output flagged as silence too.
+//  The heads keep moving either way, so the tremolo picks up in step when the input returns.
+//  The other channels, or the other slices of a buffer with scheduled parameters, may
+//  still be sounding, which clears the flag for the whole buffer, so a skipped channel
+//  writes its silence out.
 void TremoloUnit::TremoloUnitKernel::Process (
 	const Float32 	*inSourceP,			// The audio sample input buffer.
 	Float32		 	*inDestP,			// The audio sample output buffer.
 	UInt32 			inSamplesToProcess,	// The number of samples in the input buffer.
-	UInt32			inNumChannels,		// The number of input channels. This is always equal to 1 because there
-                                        //  is always one kernel object instantiated per channel of audio.
+	UInt32			inNumChannels,		// The number of interleaved channels, and so the distance between this
+                                        //  channel's samples; 1 for deinterleaved buffers.
 	bool			&ioSilence			// A Boolean flag indicating whether the input to the audio unit
                                         //  consists of silence, with a TRUE value indicating silence.
 ) {
-	if (!ioSilence) {
-		// Assigns a pointer variable to the start of the audio sample input buffer.
-		const Float32 *sourceP = inSourceP;
-		// Assigns a pointer variable to the start of the audio sample output buffer.
-		Float32	*destP = inDestP,
-                mix,
-                ringMix,
-				ring,
-                ringDepth,
-                signalPowerDepth,
-                depth,
-                signalPower,
-                signalPowerScale,
-                delayPower,
-                delayPowerScale;
-        int     length,
-                samplesPerDelay,
-                samplesPerRingDelay,
-                samplesPerSignalPowerDelay,
-                direction,
-                speed,
-                signature,
-                ringDirection,
-                ringSpeed,
-                ringSignature,
-                fade,
-                duck,
-                signalPowerDirection,
-                signalPowerSignature,
-                signalPowerSpeed;
-        
-        // ---- UPDATE PARAMETERS ---- //
-        length = GetParameter (kParameter_Length);
-        if (length < kMinimumValue_Length) length = kMinimumValue_Length;
-        if (length > kMaximumValue_Length) length = kMaximumValue_Length;
-        if (length != lastLength) lastLength = length;
-        
-        direction =  (int) GetParameter (kParameter_Direction);
-        if (direction == kForward_Direction) direction = 1;
-        else direction = -1;
-        
-        mix = GetParameter (kParameter_Mix);
-        if (mix < kMinimumValue_Mix) mix = kMinimumValue_Mix;
-        if (mix > kMaximumValue_Mix) mix = kMaximumValue_Mix;
-        if (mix != lastMix) lastMix= mix;
-        
-        signature = (int) GetParameter(kParameter_Signature);
-        if (signature < kMinimumValue_Signature) signature = kMinimumValue_Signature;
-        if (signature > kMaximumValue_Signature) signature = kMaximumValue_Signature;
-        if (signature != lastSignature) lastSignature = signature;
-        
-        speed = (int) GetParameter(kParameter_Speed);
-        if (speed < kMinimumValue_Speed) speed = kMinimumValue_Speed;
-        if (speed > kMaximumValue_Speed) speed = kMaximumValue_Speed;
-        if (speed != lastSpeed) lastSpeed = speed;
-        
-		depth = GetParameter (kParameter_Depth);
-        if (depth < kMinimumValue_Depth) depth = kMinimumValue_Depth;
-        if (depth > kMaximumValue_Depth) depth = kMaximumValue_Depth;
-        if (depth != lastDepth) lastDepth = depth;
-        
-        delayPower = GetParameter (kParameter_Delay_Power);
-        if (delayPower < kMinimumValue_Delay_Power) delayPower = kMinimumValue_Delay_Power;
-        if (delayPower > kMaximumValue_Delay_Power) delayPower = kMaximumValue_Delay_Power;
-        if (delayPower != lastDelayPower) lastDelayPower = delayPower;
-        
-        delayPowerScale = GetParameter (kParameter_Delay_Power_Scale);
-        if (delayPowerScale < kMinimumValue_Delay_Power_Scale) delayPower = kMinimumValue_Delay_Power_Scale;
-        if (delayPowerScale > kMaximumValue_Delay_Power_Scale) delayPower = kMaximumValue_Delay_Power_Scale;
-        if (delayPowerScale != lastDelayPowerScale) lastDelayPowerScale = delayPowerScale;
-        
-        ringDirection =  (int) GetParameter (kParameter_Ring_Direction);
-        if (ringDirection == kForward_Ring_Direction) ringDirection = 1;
-        else ringDirection = -1;
-        
-        ringMix = GetParameter(kParameter_Ring_Mix);
-        if (ringMix < kMinimumValue_Ring_Mix) ringMix = kMinimumValue_Ring_Mix;
-        if (ringMix > kMaximumValue_Ring_Mix) ringMix = kMaximumValue_Ring_Mix;
-        if (ringMix != lastRingMix) lastRingMix = ringMix;
-        
-        ring = GetParameter(kParameter_Ring);
-        if (ring < kMinimumValue_Ring) ring = kMinimumValue_Ring;
-        if (ring > kMaximumValue_Ring) ring = kMaximumValue_Ring;
-        if (ring != lastRing) lastRing = ring;
-        
-        ringSignature = (int) GetParameter(kParameter_Ring_Signature);
-        if (ringSignature < kMinimumValue_Ring_Signature) ringSignature = kMinimumValue_Ring_Signature;
-        if (ringSignature > kMaximumValue_Ring_Signature) ringSignature = kMaximumValue_Ring_Signature;
-        if (ringSignature != lastRingSignature) lastRingSignature = ringSignature;
-        
-        ringSpeed = (int) GetParameter(kParameter_Ring_Speed);
-        if (ringSpeed < kMinimumValue_Ring_Speed) ringSpeed = kMinimumValue_Ring_Speed;
-        if (ringSpeed > kMaximumValue_Ring_Speed) ringSpeed = kMaximumValue_Ring_Speed;
-        if (ringSpeed != lastRingSpeed) lastRingSpeed = ringSpeed;
-        
-        ringDepth = GetParameter (kParameter_Ring_Depth);
-        if (ringDepth < kMinimumValue_Ring_Depth) ringDepth = kMinimumValue_Ring_Depth;
-        if (ringDepth > kMaximumValue_Depth) ringDepth = kMaximumValue_Ring_Depth;
-        if (ringDepth != lastRingDepth) lastRingDepth = ringDepth;
-        
-        signalPowerDirection =  (int) GetParameter (kParameter_Signal_Power_Direction);
-        if (signalPowerDirection == kForward_Signal_Power_Direction) signalPowerDirection = 1;
-        else signalPowerDirection = -1;
-        
-        signalPower = GetParameter (kParameter_Signal_Power);
-        if (signalPower	< kMinimumValue_Signal_Power) signalPower = kMinimumValue_Signal_Power;
-        if (signalPower	> kMaximumValue_Signal_Power) signalPower = kMaximumValue_Signal_Power;
-        if (signalPower != lastSignalPower) lastSignalPower = signalPower;
-        
-        signalPowerScale = GetParameter (kParameter_Signal_Power_Scale);
-        if (signalPowerScale < kMinimumValue_Signal_Power_Scale) signalPowerScale = kMinimumValue_Signal_Power_Scale;
-        if (signalPowerScale > kMaximumValue_Signal_Power_Scale) signalPowerScale = kMaximumValue_Signal_Power_Scale;
-        if (signalPowerScale != lastSignalPowerScale) lastSignalPowerScale = signalPowerScale;
-        
-        signalPowerSignature = (int) GetParameter(kParameter_Signal_Power_Signature);
-        if (signalPowerSignature < kMinimumValue_Signal_Power_Signature) ringSignature = kMinimumValue_Signal_Power_Signature;
-        if (signalPowerSignature > kMaximumValue_Signal_Power_Signature) ringSignature = kMaximumValue_Signal_Power_Signature;
-        if (signalPowerSignature != lastSignalPowerSignature) lastSignalPowerSignature = signalPowerSignature;
-        
-        signalPowerSpeed = (int) GetParameter(kParameter_Signal_Power_Speed);
-        if (signalPowerSpeed < kMinimumValue_Signal_Power_Speed) signalPowerSpeed = kMinimumValue_Signal_Power_Speed;
-        if (signalPowerSpeed > kMaximumValue_Signal_Power_Speed) signalPowerSpeed = kMaximumValue_Signal_Power_Speed;
-        if (signalPowerSpeed != lastSignalPowerSpeed) lastSignalPowerSpeed = signalPowerSpeed;
-        
-        signalPowerDepth = GetParameter (kParameter_Signal_Power_Depth);
-        if (signalPowerDepth < kMinimumValue_Signal_Power_Depth) signalPowerDepth = kMinimumValue_Signal_Power_Depth;
-        if (signalPowerDepth > kMaximumValue_Signal_Power_Depth) signalPowerDepth = kMaximumValue_Signal_Power_Depth;
-        if (signalPowerDepth != lastSignalPowerDepth) lastSignalPowerDepth = signalPowerDepth;
-        
-        fade = GetParameter (kParameter_Fade);
-        if (fade < kMinimumValue_Fade) fade = kMinimumValue_Fade;
-        if (fade > kMaximumValue_Fade) fade = kMaximumValue_Fade;
-        if (fade != lastFade) lastFade = fade;
-        
-        duck = GetParameter (kParameter_Duck);
-        if (duck < kMinimumValue_Duck) duck = kMinimumValue_Duck;
-        if (duck > kMaximumValue_Fade) duck = kMaximumValue_Duck;
-        if (duck != lastDuck) lastDuck = duck;
-        // ---- END UPDATE PARAMETERS ---- //
-        
-        Float64		bpm;
-        OSStatus	err	= mAudioUnit->CallHostBeatAndTempo(NULL, &bpm);
-        if (err == noErr) { bps = bpm/60; }
-        
-        samplesPerDelay = (int) (mSampleFrequency*length/(bps*signature*speed));
-        samplesPerRingDelay = (int) (mSampleFrequency*length/(bps*ringSignature*ringSpeed));
-        samplesPerSignalPowerDelay = (int) (mSampleFrequency*length/(bps*signalPowerSignature*signalPowerSpeed));
-        
-        int n = inSamplesToProcess;
-        last = *sourceP;
-        while(n--) {
-            if (head == 0) {
-                if (samplesPerDelay != lastRate) {
-                    lastRate = samplesPerDelay;
-                    memset(lastDelay,0,sizeof(float)*lastRate);
-                    memset(delay,0,sizeof(float)*lastRate);
-                }
-                if (samplesPerRingDelay != lastRingRate) {
-                    lastRingRate = samplesPerRingDelay;
-                    memset(lastRingDelay,0,sizeof(float)*lastRingRate);
-                    memset(ringDelay,0,sizeof(float)*lastRingRate);
-                }
-                if (samplesPerSignalPowerDelay != lastSignalPowerRate) {
-                    lastSignalPowerRate = samplesPerSignalPowerDelay;
-                    memset(lastSignalPowerDelay,0,sizeof(float)*maxDelaySamples);
-                    memset(signalPowerDelay,0,sizeof(float)*maxDelaySamples);
-                }
-                
-                if (direction != lastDirection) lastDirection = direction;
-                if (ringDirection != lastRingDirection) lastRingDirection = ringDirection;
-                if (signalPowerDirection != lastSignalPowerDirection) lastSignalPowerDirection = signalPowerDirection;
-            }
-            
-            last = *sourceP++;
-            
-            float mod;
-            if (lastFade == 0) mod = 1;
-            else mod = lastFade*sinf(pi*head/(lastRate));
-            if (mod < 0) mod = 0;
-            else if (mod > 1) mod = 1;
-            mod = (lastDuck*mod + 1)/(lastDuck+1);
-            
-            float rmod;
-            if (lastFade == 0) rmod = 1;
-            else rmod = lastFade*sinf(pi*rhead/(lastRingRate));
-            if (rmod < 0) rmod = 0;
-            else if (rmod > 1) rmod = 1;
-            rmod = (lastDuck*rmod + 1)/(lastDuck+1);
-            
-            float pmod;
-            if (lastFade == 0) pmod = 1;
-            else pmod = lastFade*sinf(pi*phead/(lastSignalPowerRate));
-            if (pmod < 0) pmod = 0;
-            else if (pmod > 1) pmod = 1;
-            pmod = (lastDuck*pmod + 1)/(lastDuck+1);
-
-            
-            delay[head] = (delay[(lastRate+head-1)%(lastRate)] + delay[head] + delay[(head+1)%(lastRate)])/3;
-            ringDelay[rhead] = (ringDelay[(lastRingRate+rhead-1)%(lastRingRate)] + ringDelay[rhead]
-                                + ringDelay[(rhead+1)%(lastRingRate)])/3;
-            signalPowerDelay[phead] = (signalPowerDelay[(lastSignalPowerRate+phead-1)%(lastSignalPowerRate)]
-                                       + signalPowerDelay[phead]
-                                       + signalPowerDelay[(phead+1)%(lastSignalPowerRate)])/3;
-            
-//            delay[head] = (delay[(lastRate+head-2)%(lastRate)] + 2*delay[(lastRate+head-1)%(lastRate)]
-//                           + 3*delay[head] + 2*delay[(head+1)%(lastRate)] + delay[(head+2)%(lastRate)])/9;
-//            ringDelay[rhead] = (ringDelay[(lastRingRate+rhead-2)%(lastRingRate)]
-//                                + 2*ringDelay[(lastRingRate+rhead-1)%(lastRingRate)] + 3*ringDelay[rhead]
-//                                + 2*ringDelay[(rhead+1)%(lastRingRate)] + ringDelay[(rhead+2)%(lastRingRate)])/9;
-//            signalPowerDelay[phead] = (signalPowerDelay[(lastSignalPowerRate+phead-2)%(lastSignalPowerRate)]
-//                                       + 2*signalPowerDelay[(lastSignalPowerRate+phead-1)%(lastSignalPowerRate)]
-//                                       + 3*signalPowerDelay[phead]
-//                                       + 2*signalPowerDelay[(phead+1)%(lastSignalPowerRate)]
-//                                       + signalPowerDelay[(phead+2)%(lastSignalPowerRate)])/9;
-            
-            *destP++ = (1-lastRingMix)*((1-lastMix)*last + mod*lastMix*delay[head])
-                        + lastRingMix*(
-                                       lastRing*(ringDelay[head]*ringDelay[(lastRingRate-rhead)%(lastRingRate)])
-                                        + mod*pow(lastDelayPowerScale*delay[head], lastDelayPower)
-                                        + pmod*pow(lastSignalPowerScale*signalPowerDelay[phead], lastSignalPower)
-                                       );
-
-            head = (head+1)%(lastRate);
-            rhead = (rhead+1)%(lastRingRate);
-            phead = (phead+1)%(lastSignalPowerRate);
-            
-            if (lastDirection > 0) dhead = head;
-            else dhead = (lastRate-head)%(lastRate);
-            if (lastRingDirection > 0) rdhead = rhead;
-            else rdhead = (lastRingRate-rhead)%(lastRingRate);
-            if (signalPowerDirection > 0) pdhead = phead;
-            else pdhead = (lastSignalPowerRate-phead)%(lastSignalPowerRate);
-            
-            // write delay line
-            lastDelay[dhead] = (lastDelay[(lastRate+dhead-1)%(lastRate)] + last + lastDelay[(dhead+1)%(lastRate)])/3;
-            delay[dhead] = lastDelay[dhead] + lastDepth*delay[dhead];
-            // write ring delay line
-            lastRingDelay[rdhead] = (lastRingDelay[(lastRingRate+rdhead-1)%(lastRingRate)] + last + lastRingDelay[(rdhead+1)%(lastRingRate)])/3;
-            ringDelay[rdhead] = lastRingDelay[rdhead] + lastRingDepth*ringDelay[rdhead];
-            // write exponent delay line
-            lastSignalPowerDelay[pdhead] = (lastSignalPowerDelay[(lastSignalPowerRate+pdhead-1)%(lastSignalPowerRate)] + last
-                                            + lastSignalPowerDelay[(pdhead+1)%(lastSignalPowerRate)])/3;
-            signalPowerDelay[pdhead] = lastSignalPowerDelay[pdhead] + lastSignalPowerDepth*signalPowerDelay[pdhead];
-        }
+	uint64_t start = RenderMeter::Now ();
+	if (ioSilence || mCore.IsSilent (&inSourceP, 1, inNumChannels, inSamplesToProcess)) {
+		mCore.SkipFrames (inSamplesToProcess);
+		for (UInt32 i = 0; i < inSamplesToProcess; ++i) inDestP[i*inNumChannels] = 0;
+		ioSilence = true;
+	} else {
+		mCore.ProcessChannels (&inSourceP, &inDestP, 1, inNumChannels, inSamplesToProcess);
 	}
+	if (mMeter != NULL) mMeter->AddKernel (mMeterSlot, RenderMeter::Now () - start);
 }
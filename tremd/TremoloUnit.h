@@ -8,6 +8,8 @@ Tremolo Effect AU
 
 #include "AUEffectBase.h"
 #include "TremoloUnitVersion.h"
+#include "TremoloCore.h"
+#include "RenderMeter.h"
 
 #if AU_DEBUG_DISPATCHER
 	#include "AUDebugDispatcher.h"
@@ -20,149 +22,57 @@ Tremolo Effect AU
 // Constants for parameters and  factory presets
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 #pragma mark ____TremoloUnit Parameter Constants
+// The names the host shows; the values, ranges and IDs are in TremoloCore.h.
 // 2
 static CFStringRef kParamName_Length = CFSTR ("length");
-static const int kDefaultValue_Length = 8;
-static const int kMinimumValue_Length = 1;
-static const int kMaximumValue_Length = 32;
-static const long maxDelaySamples = 512*512;
 // 6
 static CFStringRef kParamName_Direction	= CFSTR ("direction");
-static const int kForward_Direction	= 1;
-static const int kBackward_Direction = 2;
-static const int kDefaultValue_Direction = kBackward_Direction;
 static CFStringRef kMenuItem_Forward = CFSTR ("forward");
 static CFStringRef kMenuItem_Backward = CFSTR ("backward");
 // 1
 static CFStringRef kParamName_Mix = CFSTR ("mix");
-static const float kDefaultValue_Mix = 0.5;
-static const float kMinimumValue_Mix = 0.0;
-static const float kMaximumValue_Mix = 1.0;
 // 3
 static CFStringRef kParamName_Signature	= CFSTR ("signature");
-static const int kDefaultValue_Signature = 1;
-static const int kMinimumValue_Signature = 1;
-static const int kMaximumValue_Signature = 5;
 // 4
 static CFStringRef kParamName_Speed	= CFSTR ("speed");
-static const int kDefaultValue_Speed = 1;
-static const int kMinimumValue_Speed = 1;
-static const int kMaximumValue_Speed = 4;
 // 5
 static CFStringRef kParamName_Depth	= CFSTR ("depth");
-static const float kDefaultValue_Depth = 0.5;
-static const float kMinimumValue_Depth = 0.0;
-static const float kMaximumValue_Depth = 1.0;
 // 19
 static CFStringRef kParamName_Delay_Power = CFSTR ("delay exponent");
-static const int kDefaultValue_Delay_Power = 2;
-static const int kMinimumValue_Delay_Power = 1.0;
-static const int kMaximumValue_Delay_Power = 5.0;
 // 20
 static CFStringRef kParamName_Delay_Power_Scale = CFSTR ("del. exp. scale");
-static const float kDefaultValue_Delay_Power_Scale = 2.5;
-static const float kMinimumValue_Delay_Power_Scale = 0.0;
-static const float kMaximumValue_Delay_Power_Scale = 5.0;
 // 12
 static CFStringRef kParamName_Ring_Direction = CFSTR ("ring direction");
-static const int kForward_Ring_Direction = 1;
-static const int kBackward_Ring_Direction = 2;
-static const int kDefaultValue_Ring_Direction= kForward_Ring_Direction;
 static CFStringRef kMenuItem_Ring_Forward = CFSTR ("forward");
 static CFStringRef kMenuItem_Ring_Backward = CFSTR ("backward");
 // 7
 static CFStringRef kParamName_Ring_Mix = CFSTR ("ring mix");
-static const float kDefaultValue_Ring_Mix = 0.3;
-static const float kMinimumValue_Ring_Mix = 0.0;
-static const float kMaximumValue_Ring_Mix = 1.0;
 // 8
 static CFStringRef kParamName_Ring	= CFSTR ("ring sacle");
-static const float kDefaultValue_Ring = 0.3;
-static const float kMinimumValue_Ring = 0.0;
-static const float kMaximumValue_Ring = 4.0;
 // 9
 static CFStringRef kParamName_Ring_Signature = CFSTR ("ring signature");
-static const int kDefaultValue_Ring_Signature = 3;
-static const int kMinimumValue_Ring_Signature = 1;
-static const int kMaximumValue_Ring_Signature = 5;
 // 10
 static CFStringRef kParamName_Ring_Speed = CFSTR ("ring speed");
-static const int kDefaultValue_Ring_Speed = 2;
-static const int kMinimumValue_Ring_Speed = 1;
-static const int kMaximumValue_Ring_Speed = 4;
 // 11
 static CFStringRef kParamName_Ring_Depth = CFSTR ("ring depth");
-static const float kDefaultValue_Ring_Depth	= 0.7;
-static const float kMinimumValue_Ring_Depth	= 0.0;
-static const float kMaximumValue_Ring_Depth	= 1.0;
 // 18
 static CFStringRef kParamName_Signal_Power_Direction = CFSTR ("sig. exp. direction");
-static const int kForward_Signal_Power_Direction = 1;
-static const int kBackward_Signal_Power_Direction = 2;
-static const int kDefaultValue_Signal_Power_Direction= kForward_Signal_Power_Direction;
 static CFStringRef kMenuItem_Signal_Power_Forward = CFSTR ("forward");
 static CFStringRef kMenuItem_Signal_Power_Backward = CFSTR ("backward");
 // 13
 static CFStringRef kParamName_Signal_Power = CFSTR ("signal exponent");
-static const float kDefaultValue_Signal_Power = 3.0;
-static const float kMinimumValue_Signal_Power = 1.0;
-static const float kMaximumValue_Signal_Power = 5.0;
 // 14
 static CFStringRef kParamName_Signal_Power_Scale = CFSTR ("sig. exp. scale");
-static const float kDefaultValue_Signal_Power_Scale = 2.0;
-static const float kMinimumValue_Signal_Power_Scale = 0.0;
-static const float kMaximumValue_Signal_Power_Scale = 5.0;
 // 15
 static CFStringRef kParamName_Signal_Power_Signature = CFSTR ("sig. exp. signature");
-static const int kDefaultValue_Signal_Power_Signature = 5;
-static const int kMinimumValue_Signal_Power_Signature = 1;
-static const int kMaximumValue_Signal_Power_Signature = 5;
 // 16
 static CFStringRef kParamName_Signal_Power_Speed = CFSTR ("sig. exp. speed");
-static const int kDefaultValue_Signal_Power_Speed = 2;
-static const int kMinimumValue_Signal_Power_Speed = 1;
-static const int kMaximumValue_Signal_Power_Speed = 4;
 // 17
 static CFStringRef kParamName_Signal_Power_Depth = CFSTR ("sig. exp. depth");
-static const float kDefaultValue_Signal_Power_Depth	= 0.6;
-static const float kMinimumValue_Signal_Power_Depth	= 0.0;
-static const float kMaximumValue_Signal_Power_Depth	= 1.0;
 // 21
 static CFStringRef kParamName_Fade = CFSTR ("fader speed");
-static const int kDefaultValue_Fade	= 5;
-static const int kMinimumValue_Fade	= 0;
-static const int kMaximumValue_Fade	= 10;
 // 22
 static CFStringRef kParamName_Duck = CFSTR ("duck amt.");
-static const int kDefaultValue_Duck	= 3;
-static const int kMinimumValue_Duck	= 0;
-static const int kMaximumValue_Duck	= 10;
-
-enum {
-    kParameter_Length                   = 0,
-    kParameter_Direction                = 1,
-    kParameter_Mix                      = 2,
-    kParameter_Signature                = 3,
-    kParameter_Speed                    = 4,
-    kParameter_Depth                    = 5,
-    kParameter_Delay_Power              = 6,
-    kParameter_Delay_Power_Scale        = 7,
-    kParameter_Ring_Direction           = 8,
-    kParameter_Ring_Mix                 = 9,
-    kParameter_Ring                     = 10,
-    kParameter_Ring_Signature           = 11,
-    kParameter_Ring_Speed               = 12,
-    kParameter_Ring_Depth               = 13,
-    kParameter_Signal_Power_Direction   = 14,
-    kParameter_Signal_Power             = 15,
-    kParameter_Signal_Power_Scale       = 16,
-    kParameter_Signal_Power_Signature   = 17,
-    kParameter_Signal_Power_Speed       = 18,
-    kParameter_Signal_Power_Depth       = 19,
-    kParameter_Fade                     = 20,
-    kParameter_Duck                     = 21,
-	kNumberOfParameters = 22
-};
 
 #pragma mark ____TremoloUnit Factory Preset Constants
 
@@ -195,6 +105,39 @@ static AUPreset kPresets [kNumberPresets] = {
 //  "Slow & Gentle" preset.
 static const int kPreset_Default = kPreset_Slow;
 
+#pragma mark ____TremoloUnit Custom Properties
+
+// custom property IDs must be 64000 or greater
+enum {
+	// A CFDataRef snapshot of what every kernel has rendered into: the delay lines, heads
+	//  and envelopes, see TremoloCore::SaveState. AUBase::SaveState only keeps the
+	//  parameters, so a host that wants a session or a bounce to pick up mid-song with
+	//  the lines already full reads this alongside it and sets it back once the unit is
+	//  initialized the same way, instead of pre-rolling. Getting it hands the caller a
+	//  CFDataRef to release. Global scope, and only while initialized and not rendering;
+	//  a Reset empties the lines again, so set it after the host's last one.
+	kTremoloUnitProperty_KernelState = 64000,
+	
+	// A RenderMeterStats of the renders since Initialize: their cost against the buffer
+	//  deadline, each kernel's share and the delay line clears. Read-only, global scope.
+	kTremoloUnitProperty_RenderMeter = 64001,
+	
+	// A RenderMeterRing * that streams a RenderMeterRecord a render from the first get
+	//  on, for one reader in the host's process; it lives as long as the unit.
+	//  Read-only, global scope.
+	kTremoloUnitProperty_RenderMeterRing = 64002
+};
+
+// Set to 0 to always render each channel with its own kernel
+#ifndef TREMOLO_LINKED_CHANNELS
+	#define TREMOLO_LINKED_CHANNELS 1
+#endif
+
+// Set to 1 to store the delay lines decimated above 96 kHz, see TremoloDelayArena
+#ifndef TREMOLO_DECIMATED_LINES
+	#define TREMOLO_DECIMATED_LINES 0
+#endif
+
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 // TremoloUnit class
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -204,11 +147,41 @@ class TremoloUnit : public AUEffectBase {
 public:
 	TremoloUnit (AudioUnit component);
 	
-#if AU_DEBUG_DISPATCHER
-	virtual ~TremoloUnit () {delete mDebugDispatcher;}
-#endif
+	virtual ~TremoloUnit () {
+		mDelayArena.Free ();
+	#if AU_DEBUG_DISPATCHER
+		delete mDebugDispatcher;
+	#endif
+	}
+	
+	virtual ComponentResult Initialize ();
+	virtual void Cleanup ();
+	
+	virtual AUKernelBase *NewKernel () {return new TremoloUnitKernel(this, &mParameters);}
+	
+	// renders every channel in one pass when the channels are linked, see Initialize
+	virtual OSStatus ProcessBufferLists (
+		AudioUnitRenderActionFlags	&ioActionFlags,
+		const AudioBufferList		&inBuffer,
+		AudioBufferList				&outBuffer,
+		UInt32						inFramesToProcess
+	);
+	
+	// reads the host tempo and refreshes mParameters once for the whole render cycle
+	virtual OSStatus Render (
+		AudioUnitRenderActionFlags	&ioActionFlags,
+		const AudioTimeStamp		&inTimeStamp,
+		UInt32						inFramesToProcess
+	);
 	
-	virtual AUKernelBase *NewKernel () {return new TremoloUnitKernel(this);}
+	// applies the parameter events that reach this slice, then runs the kernels over it;
+	//  the output is only flagged as silence when every slice of the buffer was
+	virtual OSStatus ProcessScheduledSlice (
+		void						*inUserData,
+		UInt32						inStartFrameInBuffer,
+		UInt32						inSliceFramesToProcess,
+		UInt32						inTotalBufferFrames
+	);
 	
 	virtual	ComponentResult GetParameterValueStrings (
 		AudioUnitScope			inScope,
@@ -237,10 +210,22 @@ public:
 		void					*outData
 	);
 	
+	virtual ComponentResult SetProperty (
+		AudioUnitPropertyID		inID,
+		AudioUnitScope			inScope,
+		AudioUnitElement		inElement,
+		const void				*inData,
+		UInt32					inDataSize
+	);
+	
  	// report that the audio unit supports the 
 	//	kAudioUnitProperty_TailTime property
 	virtual	bool SupportsTail () {return true;}
 	
+	// how long the delay lines ring on after the input stops, from the lengths and
+	//  depths in effect; AUEffectBase keeps rendering silent input for this long
+	virtual Float64 GetTailTime () {return mParameters.TailSeconds (GetSampleRate ());}
+	
 	// provide the audio unit version information
 	virtual ComponentResult	Version () {return kTremoloUnitVersion;}
 
@@ -260,7 +245,7 @@ public:
 protected:
 	class TremoloUnitKernel : public AUKernelBase {
 		public:
-			TremoloUnitKernel (AUEffectBase *inAudioUnit);
+			TremoloUnitKernel (AUEffectBase *inAudioUnit, const TremoloParameters *inParameters);
 			
 			// *Required* overides for the process method for this effect
 			// processes one channel of interleaved samples
@@ -268,71 +253,51 @@ protected:
 				const Float32 	*inSourceP,
 				Float32		 	*inDestP,
 				UInt32 			inFramesToProcess,
-				UInt32			inNumChannels, // equal to 1
+				UInt32			inNumChannels, // the interleave stride, 1 when deinterleaved
 				bool			&ioSilence
 		);
 		
         virtual void Reset ();
+        
+            // the DSP, shared with the offline tools; linked channels go to it directly
+            TremoloCore &Core () {return mCore;}
+            
+            // where Process adds its time, as the inSlot'th kernel
+            void SetMeter (RenderMeter *inMeter, int inSlot) {mMeter = inMeter; mMeterSlot = inSlot;}
 		
 		private:
 			Float32 mSampleFrequency;			// The "sample rate" of the audio signal being processed
 			long	mSamplesProcessed;
-
-            float bps = 1;
-        
-            int head = 0;
-            int dhead = 0;
-        
-            int rhead = 0;
-            int rdhead = 0;
-        
-            int phead = 0;
-            int pdhead = 0;
-        
-//            bool first = true;
-//            bool firstRing = true;
-        
-            float last;
-        
-            float lastDelay[maxDelaySamples];
-            float delay[maxDelaySamples];
         
-            float lastRingDelay[maxDelaySamples];
-            float ringDelay[maxDelaySamples];
-        
-            float lastSignalPowerDelay[maxDelaySamples];
-            float signalPowerDelay[maxDelaySamples];
-        
-            int lastRate = 4096*4;
-            int lastRingRate = 2048*3;
-            int lastSignalPowerRate = 1024*5;
-        
-            int lastLength = 1;
-            int lastDirection = 1;
-            float lastMix = 0.5;
-            int lastSignature = 1;
-            int lastSpeed = 1;
-            float lastDepth = 0;
-            int lastDelayPower = 0;
-            float lastDelayPowerScale = 2;
-        
-            int lastRingDirection = 1;
-            float lastRingMix = 0.5;
-            float lastRing = 0;
-            int lastRingSignature = 1;
-            int lastRingSpeed = 1;
-            float lastRingDepth = 0;
-        
-            int lastSignalPowerDirection = 1;
-            int lastSignalPower = 0;
-            float lastSignalPowerScale = 0;
-            int lastSignalPowerSignature = 0;
-            int lastSignalPowerSpeed = 0;
-            float lastSignalPowerDepth = 0.5;
-        
-            int lastFade = 1;
-            int lastDuck = 2;
+            TremoloCore mCore;
+            RenderMeter *mMeter = NULL;
+            int mMeterSlot = 0;
     };
+    
+private:
+	void UpdateParameters ();
+	UInt32 GetScheduledValues (
+		SInt32					inFrame,
+		AudioUnitParameterValue	*outValues,
+		AudioUnitParameterValue	*outSteps
+	);
+	void UpdateDerivedParameters (const TremoloParameters &inPrevious);
+	
+	// the core of the inIndex'th kernel, or NULL when there is no kernel there
+	TremoloCore *KernelCore (size_t inIndex) const;
+	CFDataRef CopyKernelState () const;
+	OSStatus RestoreKernelState (CFDataRef inState);
+	
+	TremoloParameters	mParameters;			// shared read-only by the kernels
+	Float64				mBeatsPerSecond = 1;	// last tempo the host reported
+	bool				mDelayLengthsChanged = true;	// the tempo or the capacity changed
+	UInt32				mScheduledParameters = 0;		// one bit per parameter with events this cycle
+	bool				mSliceInputSilent = false;		// the input's silence flag, for every slice of the buffer
+	bool				mSlicesSounded = false;			// some slice of the buffer has rendered output
+	
+	TremoloDelayArena	mDelayArena;			// backs every kernel's delay lines
+	int					mLinkedChannels = 0;	// channels rendered together by the first kernel, or 0
+	RenderMeter			mRenderMeter;			// see kTremoloUnitProperty_RenderMeter
 };
 
 #endif